@@ -0,0 +1,278 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Pass-through channel multiplexer.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "channel_mux.h"
+
+
+// FNV-1a hash of NULL-terminated string
+static uint32_t topic_hash (const char *str)
+{
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+// Write payload to serial output. With software flow control, XON and
+// XOFF characters in the payload would pause or resume the back-end's
+// output, so they are dropped (GUI-O messages are plain text, and
+// compressed payloads never contain them).
+static size_t write_payload (Print &output, const uint8_t *data, uint16_t length)
+{
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_SOFTWARE
+    size_t written = 0;
+    uint16_t start = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        if (data[i] == 0x11 || data[i] == 0x13) {
+            written += output.write(data + start, i - start);
+            start = i + 1;
+        }
+    }
+    written += output.write(data + start, length - start);
+    return written;
+#else
+    return output.write(data, length);
+#endif
+}
+
+
+ChannelMux::ChannelMux ()
+    : pendingMessages(0),
+      currentChannel(0),
+      currentCredited(false),
+      writtenBytes(0)
+{
+    memset(topics, 0, sizeof(topics));
+    memset(topicHashes, 0, sizeof(topicHashes));
+    memset(queues, 0, sizeof(queues));
+    memset(stats, 0, sizeof(stats));
+
+    rebuildLookup();
+}
+
+
+void ChannelMux::setTopic (uint8_t channel, const char *topic)
+{
+    if (channel >= _GUIO_CHANNELS) {
+        return;
+    }
+
+    // Empty topic marks unused channel
+    if (topic && !topic[0]) {
+        topic = nullptr;
+    }
+
+    // NOTE: we keep the pointer, so the topic storage (i.e., the
+    // parameters struct) must outlive the mux
+    topics[channel] = topic;
+    topicHashes[channel] = topic ? topic_hash(topic) : 0;
+
+    rebuildLookup();
+}
+
+void ChannelMux::rebuildLookup ()
+{
+    memset(lookupSlots, -1, sizeof(lookupSlots));
+
+    for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+        if (!topics[channel]) {
+            continue;
+        }
+
+        // Linear probing; table is always less than full
+        uint8_t slot = topicHashes[channel] % LOOKUP_SLOTS;
+        while (lookupSlots[slot] >= 0) {
+            slot = (slot + 1) % LOOKUP_SLOTS;
+        }
+        lookupSlots[slot] = channel;
+    }
+}
+
+int ChannelMux::lookupTopic (const char *topic) const
+{
+    uint32_t hash = topic_hash(topic);
+    uint8_t slot = hash % LOOKUP_SLOTS;
+
+    while (lookupSlots[slot] >= 0) {
+        int8_t channel = lookupSlots[slot];
+        if (topicHashes[channel] == hash && strcmp(topics[channel], topic) == 0) {
+            return channel;
+        }
+        slot = (slot + 1) % LOOKUP_SLOTS;
+    }
+
+    return -1; // Not found
+}
+
+
+void ChannelMux::countReceived (uint8_t channel, unsigned int length)
+{
+    stats[channel].rxMessages++;
+    stats[channel].rxBytes += length;
+}
+
+void ChannelMux::countDropped (uint8_t channel)
+{
+    stats[channel].rxDropped++;
+}
+
+
+bool ChannelMux::enqueue (uint8_t channel, const uint8_t *payload, unsigned int length)
+{
+    queue_t &queue = queues[channel];
+
+    // Check for free space (payload + 16-bit length)
+    if (queue.used + 2 + length > sizeof(queue.data)) {
+        stats[channel].txDropped++;
+        return false;
+    }
+
+    uint16_t tail = (queue.head + queue.used) % sizeof(queue.data);
+
+    queue.data[tail] = length & 0xFF;
+    tail = (tail + 1) % sizeof(queue.data);
+    queue.data[tail] = (length >> 8) & 0xFF;
+    tail = (tail + 1) % sizeof(queue.data);
+
+    for (unsigned int i = 0; i < length; i++) {
+        queue.data[tail] = payload[i];
+        tail = (tail + 1) % sizeof(queue.data);
+    }
+
+    queue.used += 2 + length;
+    queue.messages++;
+    pendingMessages++;
+
+    return true;
+}
+
+uint16_t ChannelMux::peekLength (uint8_t channel) const
+{
+    const queue_t &queue = queues[channel];
+    return queue.data[queue.head] | (queue.data[(queue.head + 1) % sizeof(queue.data)] << 8);
+}
+
+void ChannelMux::pop (uint8_t channel, Print &output, uint16_t length)
+{
+    queue_t &queue = queues[channel];
+
+    // Pass-through prefix; channel 0 is untagged
+    size_t written = output.print('$');
+    if (channel) {
+        written += output.print((char)('0' + channel));
+        written += output.print(':');
+    }
+
+    // Payload; at most two contiguous chunks due to wrap-around
+    uint16_t start = (queue.head + 2) % sizeof(queue.data);
+    uint16_t chunk = sizeof(queue.data) - start;
+    if (chunk > length) {
+        chunk = length;
+    }
+    written += write_payload(output, queue.data + start, chunk);
+    written += write_payload(output, queue.data, length - chunk);
+
+    written += output.println();
+    writtenBytes += written;
+
+    queue.head = (start + length) % sizeof(queue.data);
+    queue.used -= 2 + length;
+    queue.messages--;
+    pendingMessages--;
+
+    stats[channel].txMessages++;
+    stats[channel].txBytes += length;
+}
+
+bool ChannelMux::writeNext (Print &output)
+{
+    // Deficit round-robin: each channel is credited with a quantum of
+    // bytes when its turn comes, and may write messages as long as its
+    // credit covers them. This way, a channel with large or frequent
+    // messages cannot starve the others on the shared serial link.
+    while (pendingMessages) {
+        queue_t &queue = queues[currentChannel];
+
+        if (queue.used) {
+            if (!currentCredited) {
+                queue.deficit += _GUIO_CHANNEL_QUANTUM;
+                currentCredited = true;
+            }
+
+            uint16_t length = peekLength(currentChannel);
+            if (length <= queue.deficit) {
+                pop(currentChannel, output, length);
+                queue.deficit -= length;
+                if (!queue.used) {
+                    queue.deficit = 0; // idle channels do not accumulate credit
+                }
+                return true;
+            }
+        } else {
+            queue.deficit = 0;
+        }
+
+        // Next channel
+        currentChannel = (currentChannel + 1) % _GUIO_CHANNELS;
+        currentCredited = false;
+    }
+
+    return false; // Nothing to write
+}
+
+
+const channel_stats_t &ChannelMux::getStats (uint8_t channel) const
+{
+    return stats[channel];
+}
+
+uint16_t ChannelMux::getQueuedMessages (uint8_t channel) const
+{
+    return queues[channel].messages;
+}
+
+unsigned int ChannelMux::getQueuedBytes () const
+{
+    unsigned int bytes = 0;
+    for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+        bytes += queues[channel].used;
+    }
+    return bytes;
+}
+
+uint32_t ChannelMux::getWrittenBytes () const
+{
+    return writtenBytes;
+}
+
+
+int ChannelMux::parseTag (const char *line, const char **payload)
+{
+    // Pass-through lines are either "$<payload>" (channel 0) or
+    // "$<ch>:<payload>". GUI-O commands never start with a digit, so
+    // the tag is unambiguous.
+    if (line[0] != '$') {
+        return -1;
+    }
+
+    if (line[1] >= '0' && line[1] <= '9' && line[2] == ':') {
+        int channel = line[1] - '0';
+        if (channel >= _GUIO_CHANNELS) {
+            return -1;
+        }
+        *payload = line + 3;
+        return channel;
+    }
+
+    *payload = line + 1;
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Pass-through channel multiplexer.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__CHANNEL_MUX_H
+#define GUIO_ESP8266__CHANNEL_MUX_H
+
+#include "config.h"
+
+#include <Arduino.h>
+
+
+static_assert(_GUIO_CHANNELS >= 1 && _GUIO_CHANNELS <= 10, "Channel tag is a single digit!");
+
+
+struct channel_stats_t
+{
+    // Serial -> MQTT
+    uint32_t rxMessages;
+    uint32_t rxBytes;
+    uint32_t rxDropped; // not published (not connected, or publish failed)
+    // MQTT -> serial
+    uint32_t txMessages;
+    uint32_t txBytes;
+    uint32_t txDropped; // dropped due to full queue
+};
+
+
+class ChannelMux
+{
+public:
+    ChannelMux ();
+
+    // Topic-to-channel mapping
+    void setTopic (uint8_t channel, const char *topic);
+    int lookupTopic (const char *topic) const;
+
+    // Serial -> MQTT direction (accounting only; messages are published
+    // immediately)
+    void countReceived (uint8_t channel, unsigned int length);
+    void countDropped (uint8_t channel);
+
+    // MQTT -> serial direction
+    bool enqueue (uint8_t channel, const uint8_t *payload, unsigned int length);
+    bool writeNext (Print &output);
+
+    const channel_stats_t &getStats (uint8_t channel) const;
+    uint16_t getQueuedMessages (uint8_t channel) const;
+    unsigned int getQueuedBytes () const; // all channels
+    uint32_t getWrittenBytes () const; // all channels, including framing
+
+    static int parseTag (const char *line, const char **payload);
+
+protected:
+    void rebuildLookup ();
+
+    uint16_t peekLength (uint8_t channel) const;
+    void pop (uint8_t channel, Print &output, uint16_t length);
+
+protected:
+    // Topic lookup; open-addressing hash table of channel indices
+    static const uint8_t LOOKUP_SLOTS = 16;
+
+    const char *topics[_GUIO_CHANNELS];
+    uint32_t topicHashes[_GUIO_CHANNELS];
+    int8_t lookupSlots[LOOKUP_SLOTS];
+
+    // Per-channel ring buffers; each message is stored as 16-bit length
+    // followed by the payload
+    struct queue_t
+    {
+        uint8_t data[_GUIO_CHANNEL_QUEUE_SIZE];
+        uint16_t head;
+        uint16_t used;
+        uint16_t messages;
+        uint16_t deficit; // deficit round-robin counter
+    };
+
+    queue_t queues[_GUIO_CHANNELS];
+    uint16_t pendingMessages;
+    uint8_t currentChannel;
+    bool currentCredited;
+    uint32_t writtenBytes;
+
+    channel_stats_t stats[_GUIO_CHANNELS];
+};
+
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Parsing of the built-in command set.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "command_parser.h"
+#include "parameters.h"
+#include "pgmspace_compat.h"
+
+
+enum CommandArgs
+{
+    ARGS_NONE = 0, // "!NAME"
+    ARGS_REQUIRED = 1, // "!NAME args"
+    ARGS_OPTIONAL = 2, // "!NAME" or "!NAME args"
+};
+
+struct command_entry_t
+{
+    char name[13]; // without the `!` prefix
+    uint8_t length; // of the name
+    uint8_t args;
+};
+
+// Indexed by Command
+static const command_entry_t COMMAND_TABLE[COMMANDS] PROGMEM = {
+    { "PING", 4, ARGS_NONE },
+    { "REBOOT", 6, ARGS_NONE },
+    { "REBOOT_AP", 9, ARGS_NONE },
+    { "CLEAR_PARAMS", 12, ARGS_NONE },
+    { "FLOW", 4, ARGS_NONE },
+    { "POWER", 5, ARGS_OPTIONAL },
+    { "MQTT", 4, ARGS_REQUIRED },
+    { "CAPTURE", 7, ARGS_OPTIONAL },
+    { "BROKER", 6, ARGS_REQUIRED },
+    { "CHANNEL", 7, ARGS_REQUIRED },
+    { "CHSTATS", 7, ARGS_NONE },
+    { "MQTTSTATS", 9, ARGS_NONE },
+    { "TRACE", 5, ARGS_OPTIONAL },
+    { "BROKERS", 7, ARGS_NONE },
+    { "CACHE", 5, ARGS_REQUIRED },
+    { "COMPRESS", 8, ARGS_OPTIONAL },
+};
+
+static_assert(sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]) == COMMANDS, "Command table does not match the Command enum!");
+
+
+Command command_parse (char *line, char **args)
+{
+    // Pass-through messages are rejected right away
+    if (line[0] != '!') {
+        return COMMAND_NONE;
+    }
+
+    // The name ends with a space or the end of line
+    char *name = line + 1;
+    uint8_t length = 0;
+    while (name[length] && name[length] != ' ') {
+        if (++length >= sizeof(COMMAND_TABLE[0].name)) {
+            return COMMAND_NONE;
+        }
+    }
+
+    // Length is compared before the name; the names are short, so they
+    // are compared in place rather than via memcmp_P()
+    for (uint8_t command = 0; command < COMMANDS; command++) {
+        const command_entry_t &entry = COMMAND_TABLE[command];
+
+        if (pgm_read_byte(&entry.length) != length) {
+            continue;
+        }
+        uint8_t i = 0;
+        while (i < length && pgm_read_byte(entry.name + i) == name[i]) {
+            i++;
+        }
+        if (i < length) {
+            continue;
+        }
+
+        uint8_t argsMode = pgm_read_byte(&entry.args);
+        char *end = name + length;
+        if (argsMode == ARGS_NONE) {
+            if (*end) {
+                return COMMAND_NONE;
+            }
+            *args = end;
+        } else if (argsMode == ARGS_REQUIRED) {
+            if (!*end) {
+                return COMMAND_NONE;
+            }
+            *args = end + 1; // skip the space
+        } else {
+            *args = end;
+        }
+
+        return (Command)command;
+    }
+
+    return COMMAND_NONE;
+}
+
+
+bool command_parse_mqtt_args (char *args, command_mqtt_args_t *result)
+{
+    char *saveptr;
+    const char *portArg = strtok_r(args, " ", &saveptr);
+    const char *modeArg = strtok_r(nullptr, " ", &saveptr);
+    const char *fingerprintArg = strtok_r(nullptr, " ", &saveptr);
+
+    if (!portArg || !modeArg) {
+        return false;
+    }
+
+    char *end;
+    unsigned long port = strtoul(portArg, &end, 10);
+    if (*end || port == 0 || port > 65535) {
+        return false;
+    }
+    result->port = port;
+
+    if (strcmp_P(modeArg, PSTR("TLS")) == 0) {
+        result->tls = true;
+    } else if (strcmp_P(modeArg, PSTR("PLAIN")) == 0) {
+        result->tls = false;
+    } else {
+        return false;
+    }
+
+    memset(result->fingerprint, 0, sizeof(result->fingerprint));
+    if (fingerprintArg && !parameters_parse_fingerprint(fingerprintArg, result->fingerprint)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool command_parse_broker_args (char *args, command_broker_args_t *result)
+{
+    static_assert(sizeof(result->hostName) == sizeof(parameters_t::mqttBackupBrokers[0].hostName), "Host name size mismatch!");
+
+    char *saveptr;
+    const char *indexArg = strtok_r(args, " ", &saveptr);
+    const char *brokerArg = strtok_r(nullptr, " ", &saveptr);
+
+    // Index 0 is the primary broker, which is configured via pairing
+    if (!indexArg || indexArg[0] < '1' || indexArg[0] > '9' || indexArg[1] || indexArg[0] - '0' > _GUIO_MQTT_BACKUP_BROKERS) {
+        return false;
+    }
+    result->index = indexArg[0] - '0';
+
+    if (brokerArg) {
+        return parameters_parse_broker(brokerArg, result->hostName, sizeof(result->hostName), &result->port);
+    }
+
+    result->hostName[0] = 0;
+    result->port = 0;
+
+    return true;
+}
+
+bool command_parse_channel_args (char *args, command_channel_args_t *result)
+{
+    char *saveptr;
+    const char *channelArg = strtok_r(args, " ", &saveptr);
+    const char *subscribeTopic = strtok_r(nullptr, " ", &saveptr);
+    const char *publishTopic = strtok_r(nullptr, " ", &saveptr);
+
+    // Channel 0 is configured via pairing
+    if (!channelArg || channelArg[0] < '1' || channelArg[0] > '9' || channelArg[1] || channelArg[0] - '0' >= _GUIO_CHANNELS) {
+        return false;
+    }
+    result->channel = channelArg[0] - '0';
+
+    // Either both topics or none (= clear)
+    if (!subscribeTopic) {
+        subscribeTopic = "";
+        publishTopic = "";
+    } else if (!publishTopic) {
+        return false;
+    }
+
+    if (strlen(subscribeTopic) >= sizeof(parameters_t::channels[0].subscribeTopic) || strlen(publishTopic) >= sizeof(parameters_t::channels[0].publishTopic)) {
+        return false;
+    }
+
+    result->subscribeTopic = subscribeTopic;
+    result->publishTopic = publishTopic;
+
+    return true;
+}
+
+bool command_parse_compress_args (const char *args, command_compress_args_t *result)
+{
+    while (*args == ' ') {
+        args++;
+    }
+
+    result->mode = 0;
+    result->hasVersion = false;
+    result->version = 0;
+
+    if (!*args) {
+        result->action = COMPRESS_ACTION_QUERY;
+        return true;
+    } else if (strcmp_P(args, PSTR("STATS")) == 0) {
+        result->action = COMPRESS_ACTION_STATS;
+        return true;
+    }
+
+    const char *version;
+    if (strncmp_P(args, PSTR("OFF"), 3) == 0) {
+        result->mode = 0;
+        version = args + 3;
+    } else if (strncmp_P(args, PSTR("SERIAL"), 6) == 0) {
+        result->mode = 1;
+        version = args + 6;
+    } else if (strncmp_P(args, PSTR("MQTT"), 4) == 0) {
+        result->mode = 2;
+        version = args + 4;
+    } else if (strncmp_P(args, PSTR("BOTH"), 4) == 0) {
+        result->mode = 3;
+        version = args + 4;
+    } else {
+        return false;
+    }
+    result->action = COMPRESS_ACTION_SET;
+
+    if (*version == ' ') {
+        char *end;
+        unsigned long requested = strtoul(version + 1, &end, 10);
+        if (*end || end == version + 1) {
+            return false;
+        }
+        result->hasVersion = true;
+        result->version = requested;
+    } else if (*version) {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,107 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Parsing of the built-in command set.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__COMMAND_PARSER_H
+#define GUIO_ESP8266__COMMAND_PARSER_H
+
+// NOTE: this module does not depend on Arduino, as it is also built
+// by the host harness (libguio_host)
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Built-in commands of both AP and STA mode; the programs decide which
+// of them they handle
+enum Command
+{
+    COMMAND_NONE = -1, // not a (known) command
+
+    // Both modes
+    COMMAND_PING = 0,
+    COMMAND_REBOOT,
+    COMMAND_REBOOT_AP,
+    COMMAND_CLEAR_PARAMS,
+    COMMAND_FLOW,
+    COMMAND_POWER,
+    COMMAND_MQTT,
+    COMMAND_CAPTURE,
+    COMMAND_BROKER,
+
+    // STA mode
+    COMMAND_CHANNEL,
+    COMMAND_CHSTATS,
+    COMMAND_MQTTSTATS,
+    COMMAND_TRACE,
+    COMMAND_BROKERS,
+    COMMAND_CACHE,
+    COMMAND_COMPRESS,
+
+    COMMANDS
+};
+
+
+// Parses the command line (e.g., "!BROKER 1 host:1883"). Returns the
+// command, or COMMAND_NONE if the line is not a known command or its
+// arguments are missing/unexpected. On success, args points to the
+// arguments within the line; for commands with optional arguments, it
+// points to the separating space (or the terminating NULL).
+Command command_parse (char *line, char **args);
+
+
+// Arguments of the configuration commands. The parsers validate the
+// arguments against the limits of parameters_t, and modify the args
+// string (tokenization); the results may point into it.
+
+// !MQTT <port> <TLS|PLAIN> [fingerprint]
+struct command_mqtt_args_t
+{
+    uint16_t port;
+    bool tls;
+    uint8_t fingerprint[20]; // all zeros if not given
+};
+
+// !BROKER <idx> [host[:port]]
+struct command_broker_args_t
+{
+    uint8_t index; // 1 .. _GUIO_MQTT_BACKUP_BROKERS
+    char hostName[32]; // empty = clear the entry
+    uint16_t port; // zero = same as primary
+};
+
+// !CHANNEL <ch> [<subscribeTopic> <publishTopic>]
+struct command_channel_args_t
+{
+    uint8_t channel; // 1 .. _GUIO_CHANNELS-1
+    const char *subscribeTopic; // both empty = clear the channel
+    const char *publishTopic;
+};
+
+// !COMPRESS [OFF|SERIAL|MQTT|BOTH [version]|STATS]
+enum CompressAction
+{
+    COMPRESS_ACTION_QUERY = 0,
+    COMPRESS_ACTION_SET,
+    COMPRESS_ACTION_STATS,
+};
+
+struct command_compress_args_t
+{
+    uint8_t action;
+    uint8_t mode; // bit 0: serial, bit 1: MQTT
+    bool hasVersion;
+    uint32_t version; // codec version of the requesting side
+};
+
+bool command_parse_mqtt_args (char *args, command_mqtt_args_t *result);
+bool command_parse_broker_args (char *args, command_broker_args_t *result);
+bool command_parse_channel_args (char *args, command_channel_args_t *result);
+bool command_parse_compress_args (const char *args, command_compress_args_t *result);
+
+
+#endif
@@ -18,6 +18,34 @@
 // Serial communication baud rate
 #define _GUIO_SERIAL_BAUDRATE 115200
 
+// Serial receive buffer size (in bytes)
+#define _GUIO_SERIAL_RX_BUFFER 1024
+
+// Serial flow control:
+//  - _GUIO_FLOW_NONE: no flow control
+//  - _GUIO_FLOW_HARDWARE: RTS/CTS on _GUIO_SERIAL_RTS_PIN and GPIO13
+//    (D7, U0CTS); both lines are active-low
+//  - _GUIO_FLOW_SOFTWARE: XON/XOFF
+#define _GUIO_FLOW_NONE 0
+#define _GUIO_FLOW_HARDWARE 1
+#define _GUIO_FLOW_SOFTWARE 2
+
+#define _GUIO_SERIAL_FLOW_CONTROL _GUIO_FLOW_NONE
+
+// RTS pin for hardware flow control; GPIO15 (D8) is pulled low at boot,
+// which corresponds to asserted RTS
+#define _GUIO_SERIAL_RTS_PIN 15
+
+// Fill level of the serial receive buffer (in bytes) at which the
+// back-end is paused, and level at which it is resumed
+#define _GUIO_SERIAL_FLOW_HIGH 512
+#define _GUIO_SERIAL_FLOW_LOW 128
+
+// Buffer for command responses that are held back while the back-end
+// has paused our output (in bytes); responses that do not fit are
+// dropped
+#define _GUIO_SERIAL_REPLY_BUFFER 512
+
 // LED used for main signalling tasks (e.g., built-in LED)
 #define _GUIO_LED_MAIN LED_BUILTIN
 
@@ -25,6 +53,122 @@
 #define _GUIO_AP_BUTTON D4
 
 
+// Number of pass-through channels. Channel 0 uses the untagged `$`
+// prefix and the topics from pairing; channels 1 .. N-1 use `$<ch>:`
+// prefix and topics configured via `!CHANNEL` command (max. 10)
+#define _GUIO_CHANNELS 4
+
+// Size of per-channel queue for MQTT -> serial messages (in bytes)
+#define _GUIO_CHANNEL_QUEUE_SIZE 512
+
+// Scheduling quantum for serial output of channel queues (in bytes)
+#define _GUIO_CHANNEL_QUANTUM 128
+
+// Size of UI state cache, shared by all channels (in bytes)
+#define _GUIO_UI_CACHE_SIZE 2048
+
+
+// TLS receive and transmit buffer sizes for MQTT over TLS (in bytes).
+// Used only if the broker supports Maximum Fragment Length Negotiation
+// (MFLN) for the receive buffer size; otherwise, BearSSL's default
+// buffers (16 kB + 512 B) are used.
+#define _GUIO_TLS_RX_BUFFER 1024
+#define _GUIO_TLS_TX_BUFFER 512
+
+
+// Number of backup MQTT brokers (in addition to the primary one)
+#define _GUIO_MQTT_BACKUP_BROKERS 2
+
+// MQTT keep-alive interval (in seconds); same as PubSubClient's default.
+// A ping is sent after an interval without traffic, and the connection
+// is considered lost if the broker does not respond within another
+// interval, so a silent connection loss is detected within two
+// intervals (30 seconds). Shorter intervals detect it sooner, at the
+// cost of more frequent wake-ups of the radio (see _GUIO_POWER_ADAPTIVE).
+#define _GUIO_MQTT_KEEPALIVE 15
+
+// MQTT keep-alive interval (in seconds) used when backup brokers are
+// configured, so that a lost broker is detected (and failed over)
+// within 10 seconds
+#define _GUIO_MQTT_FAILOVER_KEEPALIVE 5
+
+// Interval between latency probes of MQTT brokers (in milliseconds);
+// one broker is probed at a time
+#define _GUIO_MQTT_PROBE_INTERVAL 20000
+
+// Timeout for latency probe connection (in milliseconds); the probe
+// blocks the main loop, so it is performed only while the serial link
+// is idle
+#define _GUIO_MQTT_PROBE_TIMEOUT 1000
+
+// Time after failure during which the broker is avoided (in milliseconds)
+#define _GUIO_MQTT_BROKER_HOLDOFF 60000
+
+// Latency margin within which brokers earlier in the list are
+// preferred (in milliseconds)
+#define _GUIO_MQTT_BROKER_MARGIN 20
+
+
+// Default latency tracing sample interval (every n-th message is
+// traced); each traced serial -> MQTT message also publishes a record
+// to the trace side topic
+#define _GUIO_TRACE_INTERVAL 64
+
+// Time after which a traced MQTT -> serial message that has not been
+// transmitted (e.g., dropped, or held by flow control) is abandoned
+// (in milliseconds)
+#define _GUIO_TRACE_TIMEOUT 1000
+
+
+// Traffic capture buffer (in bytes); records are written to the flash
+// file system periodically, and dropped if they do not fit into the
+// buffer in the meantime. Needs to hold the largest (MQTT) message.
+#define _GUIO_CAPTURE_BUFFER_SIZE 1024
+
+// Interval of writing the captured records to the flash file system
+// (in milliseconds)
+#define _GUIO_CAPTURE_FLUSH_INTERVAL 25
+
+// Maximum size of traffic capture file (in bytes)
+#define _GUIO_CAPTURE_MAX_SIZE (256*1024)
+
+
+// Traffic-adaptive power management. Based on the time since the last
+// serial or MQTT traffic, the program is in one of the states:
+//  - active: no idle sleep, WiFi modem sleep disabled
+//  - idle: idle sleep, WiFi modem sleep (wake on every DTIM beacon)
+//  - quiet: longer idle sleep, WiFi modem sleep with longer listen
+//    interval, relaxed connection checks
+// If disabled, the program always remains in the idle state.
+#define _GUIO_POWER_ADAPTIVE
+
+// Time after traffic during which the program remains active, and time
+// after which it becomes quiet (in milliseconds)
+#define _GUIO_POWER_ACTIVE_TIME 2000
+#define _GUIO_POWER_QUIET_TIME 60000
+
+// Additional sleep on idle scheduler runs in quiet state (in
+// milliseconds). Must be short enough for the serial receive buffer to
+// absorb incoming data in the meantime.
+#define _GUIO_POWER_QUIET_SLEEP 10
+
+// WiFi listen interval in quiet state (in DTIM beacon intervals);
+// inbound MQTT messages are delayed by up to this many intervals
+#define _GUIO_POWER_QUIET_LISTEN_INTERVAL 3
+
+// Connection check interval in quiet state (in milliseconds); applies
+// only while fully connected. Lost MQTT connection is still detected
+// via keep-alive (see _GUIO_MQTT_KEEPALIVE).
+#define _GUIO_POWER_QUIET_CHECK_INTERVAL 60000
+
+// Estimated supply current in each state (in mA), used to report the
+// estimated average consumption. Defaults are based on ESP8266 datasheet
+// figures, and should be adjusted to measurements of the actual board.
+#define _GUIO_POWER_ACTIVE_CURRENT 75
+#define _GUIO_POWER_IDLE_CURRENT 20
+#define _GUIO_POWER_QUIET_CURRENT 12
+
+
 // Debug macros
 // Avoid littering the code with #ifdef _GUIO_DEBUG blocks.
 // Also allows easy switch to another Serial object (e.g., Serial1).
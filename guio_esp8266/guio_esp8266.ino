@@ -25,6 +25,7 @@ static parameters_t parameters;
 void setup ()
 {
     // Initialize serial
+    Serial.setRxBufferSize(_GUIO_SERIAL_RX_BUFFER);
     Serial.begin(_GUIO_SERIAL_BAUDRATE);
     while (!Serial) {
         // Wait for serial port to connect
@@ -49,11 +50,17 @@ void setup ()
         parameters.force_ap = true; // this will force write to EEPROM
     }
 
-    // TODO: validate version, upgrade format, etc.
+    // Upgrade parameters stored by older versions of the program
+    bool upgraded = parameters_upgrade(&parameters);
+    if (upgraded) {
+        GDBG_print(F("GUI-O parameters upgraded to version "));
+        GDBG_println(parameters.version);
+    }
+
     sta_mode = parameters.configured && !parameters.force_ap;
 
     // Immediately reset the force-AP flag and store
-    if (parameters.force_ap) {
+    if (parameters.force_ap || upgraded) {
         parameters.force_ap = false;
         EEPROM.put(0, parameters);
         EEPROM.commit();
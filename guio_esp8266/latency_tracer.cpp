@@ -0,0 +1,107 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Per-hop message latency tracing.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "latency_tracer.h"
+
+
+static const char HOP_NAMES[LATENCY_HOPS][12] PROGMEM = {
+    "SERIAL_RX",
+    "DISPATCH",
+    "PUBLISH",
+    "QUEUE",
+    "SERIAL_TX",
+};
+
+
+LatencyTracer::LatencyTracer ()
+    : enabled(false),
+      sampleInterval(1),
+      sampleCounter(0),
+      traceId(0)
+{
+    reset();
+}
+
+
+void LatencyTracer::setEnabled (bool enabled, uint16_t sampleInterval)
+{
+    this->enabled = enabled;
+    this->sampleInterval = sampleInterval ? sampleInterval : 1;
+    sampleCounter = 0;
+}
+
+bool LatencyTracer::isEnabled () const
+{
+    return enabled;
+}
+
+
+bool LatencyTracer::sample ()
+{
+    if (!enabled) {
+        return false;
+    }
+
+    // Every N-th message
+    if (++sampleCounter < sampleInterval) {
+        return false;
+    }
+    sampleCounter = 0;
+
+    traceId++;
+
+    return true;
+}
+
+uint16_t LatencyTracer::getTraceId () const
+{
+    return traceId;
+}
+
+
+void LatencyTracer::addSample (LatencyHop hop, uint32_t duration)
+{
+    histogram_t &histogram = histograms[hop];
+
+    uint8_t bucket = 0;
+    while (bucket < BUCKETS - 1 && (duration >> (bucket + 1))) {
+        bucket++;
+    }
+
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.sum += duration;
+    if (duration > histogram.max) {
+        histogram.max = duration;
+    }
+}
+
+void LatencyTracer::reset ()
+{
+    memset(histograms, 0, sizeof(histograms));
+}
+
+
+void LatencyTracer::dump (Print &output) const
+{
+    // One line per hop: !TRACE <hop> <count> <mean> <max> <bucket counts...>
+    for (uint8_t hop = 0; hop < LATENCY_HOPS; hop++) {
+        const histogram_t &histogram = histograms[hop];
+
+        char name[sizeof(HOP_NAMES[0])];
+        strcpy_P(name, HOP_NAMES[hop]);
+
+        output.printf_P(PSTR("!TRACE %s %u %u %u"), name, histogram.count, histogram.count ? (uint32_t)(histogram.sum / histogram.count) : 0, histogram.max);
+        for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+            output.print(' ');
+            output.print(histogram.buckets[bucket]);
+        }
+        output.println();
+    }
+}
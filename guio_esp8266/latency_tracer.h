@@ -0,0 +1,72 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Per-hop message latency tracing.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__LATENCY_TRACER_H
+#define GUIO_ESP8266__LATENCY_TRACER_H
+
+#include "config.h"
+
+#include <Arduino.h>
+
+
+enum LatencyHop
+{
+    // Serial -> MQTT
+    HOP_SERIAL_RX = 0, // first byte of line read -> line complete
+    HOP_DISPATCH = 1, // line complete -> pass-through dispatch
+    HOP_PUBLISH = 2, // pass-through dispatch -> publish returned
+    // MQTT -> serial
+    HOP_QUEUE = 3, // MQTT receive callback -> line written to serial
+    HOP_SERIAL_TX = 4, // line written to serial -> serial TX drained
+
+    LATENCY_HOPS
+};
+
+
+class LatencyTracer
+{
+public:
+    LatencyTracer ();
+
+    void setEnabled (bool enabled, uint16_t sampleInterval);
+    bool isEnabled () const;
+
+    // Returns true if the current message should be traced; in that
+    // case, the new trace ID is available via getTraceId()
+    bool sample ();
+    uint16_t getTraceId () const;
+
+    void addSample (LatencyHop hop, uint32_t duration);
+    void reset ();
+
+    void dump (Print &output) const;
+
+protected:
+    // Bucket i holds durations in [2^i, 2^(i+1)) microseconds (with
+    // zero in the first one, and everything above in the last one)
+    static const uint8_t BUCKETS = 20;
+
+    struct histogram_t
+    {
+        uint32_t buckets[BUCKETS];
+        uint32_t count;
+        uint32_t max;
+        uint64_t sum;
+    };
+
+    bool enabled;
+    uint16_t sampleInterval;
+    uint16_t sampleCounter;
+    uint16_t traceId;
+
+    histogram_t histograms[LATENCY_HOPS];
+};
+
+
+#endif
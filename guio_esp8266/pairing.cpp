@@ -0,0 +1,136 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Parsing of GUI-O pairing requests.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pairing.h"
+
+
+// A helper for copying a string field from JSON object
+static bool copy_string_parameter (const JsonObject &object, const char *fieldName, char *destBuffer, unsigned int destBufferSize, char *errorBuffer, unsigned int errorBufferSize)
+{
+    // Grab the field
+    JsonVariant field = object[fieldName];
+    if (!field) {
+        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' not found in request object!"), fieldName);
+        return false;
+    }
+
+    // Ensure it is a string
+    const char *value = field.as<const char *>();
+    if (!value) {
+        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' in request object is not a string!"), fieldName);
+        return false;
+    }
+
+    // Copy its contents (with overflow check)
+    if (snprintf(destBuffer, destBufferSize, "%s", value) >= destBufferSize) {
+        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' in request object is too long!"), fieldName);
+        return false;
+    }
+
+    return true;
+}
+
+
+bool pairing_parse_request (const JsonVariant &json, parameters_t *params, char *errorMessage, unsigned int errorMessageSize)
+{
+    if (!json.is<JsonObject>()) {
+        snprintf_P(errorMessage, errorMessageSize, PSTR("Request payload is not a JSON object!"));
+        return false;
+    }
+
+    const JsonObject &requestObject = json.as<JsonObject>();
+
+    // Network SSID
+    if (!copy_string_parameter(requestObject, "networkSsid", params->networkSsid, sizeof(params->networkSsid), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // Network password
+    if (!copy_string_parameter(requestObject, "networkPassword", params->networkPassword, sizeof(params->networkPassword), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT host
+    if (!copy_string_parameter(requestObject, "mqttHostName", params->mqttHostName, sizeof(params->mqttHostName), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT user name
+    if (!copy_string_parameter(requestObject, "mqttUserName", params->mqttUserName, sizeof(params->mqttUserName), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT user password
+    if (!copy_string_parameter(requestObject, "mqttUserPassword", params->mqttUserPassword, sizeof(params->mqttUserPassword), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT subscribe topic (NOTE: inverted meaning!)
+    if (!copy_string_parameter(requestObject, "subscribeTopic", params->publishTopic, sizeof(params->publishTopic), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT publish topic (NOTE: inverted meaning!)
+    if (!copy_string_parameter(requestObject, "publishTopic", params->subscribeTopic, sizeof(params->subscribeTopic), errorMessage, errorMessageSize)) {
+        return false;
+    }
+
+    // MQTT port (optional)
+    JsonVariant mqttPort = requestObject["mqttPort"];
+    if (!mqttPort.isNull()) {
+        if (!mqttPort.is<unsigned int>() || mqttPort.as<unsigned int>() == 0 || mqttPort.as<unsigned int>() > 65535) {
+            snprintf_P(errorMessage, errorMessageSize, PSTR("Field 'mqttPort' in request object is not a valid port number!"));
+            return false;
+        }
+        params->mqttPort = mqttPort.as<unsigned int>();
+    }
+
+    // MQTT over TLS (optional)
+    JsonVariant mqttTls = requestObject["mqttTls"];
+    if (!mqttTls.isNull()) {
+        if (!mqttTls.is<bool>()) {
+            snprintf_P(errorMessage, errorMessageSize, PSTR("Field 'mqttTls' in request object is not a boolean!"));
+            return false;
+        }
+        params->mqttTls = mqttTls.as<bool>();
+    }
+
+    // MQTT broker certificate fingerprint (optional)
+    JsonVariant mqttFingerprint = requestObject["mqttFingerprint"];
+    if (!mqttFingerprint.isNull()) {
+        const char *value = mqttFingerprint.as<const char *>();
+        if (!value || !parameters_parse_fingerprint(value, params->mqttFingerprint)) {
+            snprintf_P(errorMessage, errorMessageSize, PSTR("Field 'mqttFingerprint' in request object is not a valid SHA-1 fingerprint!"));
+            return false;
+        }
+    }
+
+    // Backup MQTT brokers (optional); array of "host[:port]" strings
+    JsonVariant mqttBrokers = requestObject["mqttBrokers"];
+    if (!mqttBrokers.isNull()) {
+        if (!mqttBrokers.is<JsonArray>() || mqttBrokers.size() > _GUIO_MQTT_BACKUP_BROKERS) {
+            snprintf_P(errorMessage, errorMessageSize, PSTR("Field 'mqttBrokers' in request object is not an array of up to %d brokers!"), _GUIO_MQTT_BACKUP_BROKERS);
+            return false;
+        }
+        memset(params->mqttBackupBrokers, 0, sizeof(params->mqttBackupBrokers));
+        for (size_t i = 0; i < mqttBrokers.size(); i++) {
+            const char *value = mqttBrokers[i].as<const char *>();
+            auto &entry = params->mqttBackupBrokers[i];
+            if (!value || !parameters_parse_broker(value, entry.hostName, sizeof(entry.hostName), &entry.port)) {
+                snprintf_P(errorMessage, errorMessageSize, PSTR("Field 'mqttBrokers' in request object contains invalid broker!"));
+                return false;
+            }
+        }
+    }
+
+    // Mark as configured
+    params->configured = true;
+
+    return true;
+}
@@ -0,0 +1,28 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Parsing of GUI-O pairing requests.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__PAIRING_H
+#define GUIO_ESP8266__PAIRING_H
+
+// NOTE: this module does not depend on Arduino (other than through the
+// ArduinoJson library, which also builds on host), as it is also built
+// by the host harness (libguio_host)
+#include "parameters.h"
+
+#include <ArduinoJson.h>
+
+
+// Parses and validates the pairing request, and fills in the
+// parameters. Optional fields that are not given in the request are
+// left as they are in params. On success, the configured flag is set;
+// on failure, the reason is stored into errorMessage.
+bool pairing_parse_request (const JsonVariant &json, parameters_t *params, char *errorMessage, unsigned int errorMessageSize);
+
+
+#endif
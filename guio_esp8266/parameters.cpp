@@ -27,7 +27,98 @@ void parameters_init (parameters_t *const params)
 
     // Initialize header
     memcpy_P(params->sig, GUIO_SIGNATURE, 4);
-    params->version = 1;
+    params->version = GUIO_PARAMETERS_VERSION;
     //params->configured = false;
     //params->force_ap = false;
+
+    params->mqttPort = 1883;
+}
+
+bool parameters_upgrade (parameters_t *const params)
+{
+    if (params->version >= GUIO_PARAMETERS_VERSION) {
+        return false; // Nothing to do
+    }
+
+    // Fields that were added in newer versions contain whatever was
+    // left in EEPROM; clear them
+    if (params->version < 2) {
+        memset(params->channels, 0, sizeof(params->channels));
+    }
+    if (params->version < 3) {
+        params->mqttPort = 1883;
+        params->mqttTls = false;
+        memset(params->mqttFingerprint, 0, sizeof(params->mqttFingerprint));
+    }
+    if (params->version < 4) {
+        memset(params->mqttBackupBrokers, 0, sizeof(params->mqttBackupBrokers));
+    }
+
+    params->version = GUIO_PARAMETERS_VERSION;
+
+    return true;
+}
+
+bool parameters_parse_fingerprint (const char *str, uint8_t *fingerprint)
+{
+    // 20 hex-encoded bytes, optionally separated by colons
+    for (int i = 0; i < 20; i++) {
+        if (i > 0 && *str == ':') {
+            str++;
+        }
+
+        uint8_t byte = 0;
+        for (int j = 0; j < 2; j++) {
+            char c = *str++;
+            byte <<= 4;
+            if (c >= '0' && c <= '9') {
+                byte |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                byte |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                byte |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        fingerprint[i] = byte;
+    }
+
+    return *str == 0; // no trailing characters
+}
+
+bool parameters_has_fingerprint (const parameters_t *params)
+{
+    for (unsigned int i = 0; i < sizeof(params->mqttFingerprint); i++) {
+        if (params->mqttFingerprint[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parameters_parse_broker (const char *str, char *hostName, unsigned int hostNameSize, uint16_t *port)
+{
+    // host[:port]
+    const char *colon = strchr(str, ':');
+    unsigned int hostLen = colon ? colon - str : strlen(str);
+
+    if (!hostLen || hostLen >= hostNameSize) {
+        return false;
+    }
+
+    unsigned long value = 0; // same as primary
+    if (colon) {
+        char *end;
+        value = strtoul(colon + 1, &end, 10);
+        if (*end || value == 0 || value > 65535) {
+            return false;
+        }
+    }
+
+    memcpy(hostName, str, hostLen);
+    hostName[hostLen] = 0;
+    *port = value;
+
+    return true;
 }
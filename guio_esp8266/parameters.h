@@ -10,7 +10,12 @@
 #ifndef GUIO_ESP8266__PARAMETERS_H
 #define GUIO_ESP8266__PARAMETERS_H
 
-#include <Arduino.h>
+#include "config.h"
+#include "pgmspace_compat.h"
+
+
+// Current version of the parameters layout
+#define GUIO_PARAMETERS_VERSION 4
 
 
 struct parameters_t
@@ -36,11 +41,37 @@ struct parameters_t
     // defined from the perspective of the GUI-O phone app).
     char subscribeTopic[48];
     char publishTopic[48];
+
+    // Additional pass-through channels (1 .. _GUIO_CHANNELS-1); channel
+    // with empty subscribe topic is unused. Topics have the same
+    // (ESP8266-side) meaning as the ones above. (version 2)
+    struct {
+        char subscribeTopic[48];
+        char publishTopic[48];
+    } channels[_GUIO_CHANNELS - 1];
+
+    // MQTT broker connection settings (version 3)
+    uint16_t mqttPort;
+    bool mqttTls;
+    uint8_t mqttFingerprint[20]; // SHA-1 of broker's certificate; all zeros = not verified
+
+    // Backup MQTT brokers, in order of preference; they use the same
+    // credentials and TLS settings as the primary broker. Empty host
+    // name marks unused entry, zero port means same as primary. (version 4)
+    struct {
+        char hostName[32];
+        uint16_t port;
+    } mqttBackupBrokers[_GUIO_MQTT_BACKUP_BROKERS];
 };
 
 
 void parameters_init (parameters_t *const params);
 bool parameters_valid (const parameters_t *params);
+bool parameters_upgrade (parameters_t *const params);
+
+bool parameters_parse_fingerprint (const char *str, uint8_t *fingerprint);
+bool parameters_has_fingerprint (const parameters_t *params);
+bool parameters_parse_broker (const char *str, char *hostName, unsigned int hostNameSize, uint16_t *port);
 
 
 #endif
@@ -0,0 +1,246 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Pass-through payload compression (static dictionary + LZ).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "payload_codec.h"
+
+#include <string.h>
+
+
+// Compressed format (after the prefix, and before escaping):
+//  - 0x20 .. 0x7E: literal character
+//  - 0x01 <c>: literal character c (any other value)
+//  - 0x80 | (L << 3) | (D >> 8), D & 0xFF: match of length L + 3 at
+//    distance D + 1 (1 .. 2048) back in the window
+//
+// Escaping: NUL, LF, CR, XON, XOFF and ESC are sent as ESC (0x1B)
+// followed by the character XOR 0x40.
+#define CODEC_LITERAL 0x01
+#define CODEC_ESCAPE 0x1B
+
+#define MIN_MATCH 3
+#define MAX_MATCH (MIN_MATCH + 15)
+#define MAX_DISTANCE 2048
+#define MAX_CHAIN 16
+
+
+// Static dictionary of frequent GUI-O tokens; changing it requires
+// bumping PAYLOAD_CODEC_VERSION. Matches can reach back into the
+// dictionary from anywhere in the message, so it must be kept shorter
+// than MAX_DISTANCE - PAYLOAD_CODEC_MAX_MESSAGE.
+static const char DICTIONARY[] =
+    "@init DPW:1080 DPH:1920 "
+    "@guis SCA:1 BGC:#FFFFFF FGC:#000000 "
+    "@cls @clh @sls @hls 500 "
+    "|SL UID:sl |CB UID:cb |RB UID:rb |TI UID:ti |IM UID:im |PB UID:pb "
+    "|LED UID:led |CH UID:ch |DL UID:dl "
+    " MIN:0 MAX:100 VAL:0 VAL:1 VIS:0 VIS:1 ROT:0 RAD:0 SHE:1 HAL:0 "
+    " SBC:#FFFFFF FFA:\"\" FCO:#000000 BTH:0 BSC:#000000 "
+    "|TG UID:tg X:50 Y:50 RTO:1000 "
+    "|BT UID:bt X:50 Y:50 W:90 H:10 RTO:1000 "
+    "@bt CRE:1 @tg CRE:1 @lb TXT:\"\" "
+    "|LB UID:lb X:50 Y:10 FSZ:20 TXT:\"";
+
+static const uint16_t DICTIONARY_SIZE = sizeof(DICTIONARY) - 1;
+
+static_assert(DICTIONARY_SIZE <= 1024, "Dictionary exceeds the window reserved for it!");
+static_assert(1024 + PAYLOAD_CODEC_MAX_MESSAGE <= MAX_DISTANCE, "Dictionary must remain reachable!");
+
+
+static inline uint8_t hash3 (uint8_t a, uint8_t b, uint8_t c)
+{
+    return (uint8_t)((((uint32_t)a << 16) | ((uint32_t)b << 8) | c) * 2654435761u >> 24);
+}
+
+static inline bool needsEscape (uint8_t c)
+{
+    return c == 0x00 || c == '\n' || c == '\r' || c == 0x11 || c == 0x13 || c == CODEC_ESCAPE;
+}
+
+
+PayloadCodec::PayloadCodec ()
+{
+    memset(head, 0xFF, sizeof(head));
+
+    // Pre-load the dictionary into hash chains; these are shared by
+    // all messages
+    for (uint16_t position = 0; position + MIN_MATCH <= DICTIONARY_SIZE; position++) {
+        insert(DICTIONARY + position, position);
+    }
+
+    memcpy(dictionaryHead, head, sizeof(head));
+}
+
+
+void PayloadCodec::insert (const char *data, uint16_t position)
+{
+    uint8_t hash = hash3(data[0], data[1], data[2]);
+    prev[position] = head[hash];
+    head[hash] = position;
+}
+
+
+size_t PayloadCodec::compress (const char *input, size_t length, char *output, size_t outputSize)
+{
+    // Not worth it (or not possible)
+    if (length < 2 * MIN_MATCH || length > PAYLOAD_CODEC_MAX_MESSAGE) {
+        return 0;
+    }
+
+    // Result must be smaller than input
+    size_t limit = length - 1;
+    if (limit > outputSize) {
+        limit = outputSize;
+    }
+
+    size_t out = 0;
+    auto put = [output, limit, &out] (uint8_t c) -> bool {
+        if (needsEscape(c)) {
+            if (out + 2 > limit) {
+                return false;
+            }
+            output[out++] = CODEC_ESCAPE;
+            output[out++] = c ^ 0x40;
+        } else {
+            if (out + 1 > limit) {
+                return false;
+            }
+            output[out++] = c;
+        }
+        return true;
+    };
+
+    if (!put(PAYLOAD_CODEC_PREFIX)) {
+        return 0;
+    }
+
+    // Window = dictionary followed by input
+    memcpy(head, dictionaryHead, sizeof(head));
+    auto windowAt = [input] (uint16_t position) -> char {
+        return position < DICTIONARY_SIZE ? DICTIONARY[position] : input[position - DICTIONARY_SIZE];
+    };
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+
+        if (pos + MIN_MATCH <= length) {
+            size_t maxLength = length - pos;
+            if (maxLength > MAX_MATCH) {
+                maxLength = MAX_MATCH;
+            }
+
+            uint16_t current = DICTIONARY_SIZE + pos;
+            uint16_t candidate = head[hash3(input[pos], input[pos + 1], input[pos + 2])];
+            for (uint8_t chain = 0; candidate != NO_POSITION && chain < MAX_CHAIN; chain++) {
+                size_t matchLength = 0;
+                while (matchLength < maxLength && windowAt(candidate + matchLength) == input[pos + matchLength]) {
+                    matchLength++;
+                }
+                if (matchLength > bestLength) {
+                    bestLength = matchLength;
+                    bestDistance = current - candidate;
+                    if (bestLength == maxLength) {
+                        break;
+                    }
+                }
+                candidate = prev[candidate];
+            }
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            uint16_t distance = bestDistance - 1;
+            if (!put(0x80 | ((bestLength - MIN_MATCH) << 3) | (distance >> 8)) || !put(distance & 0xFF)) {
+                return 0;
+            }
+        } else {
+            bestLength = 1;
+            uint8_t c = input[pos];
+            if (c >= 0x20 && c <= 0x7E) {
+                if (!put(c)) {
+                    return 0;
+                }
+            } else if (!put(CODEC_LITERAL) || !put(c)) {
+                return 0;
+            }
+        }
+
+        // Add the consumed positions to hash chains
+        for (size_t i = 0; i < bestLength; i++, pos++) {
+            if (pos + MIN_MATCH <= length) {
+                insert(input + pos, DICTIONARY_SIZE + pos);
+            }
+        }
+    }
+
+    return out;
+}
+
+
+int PayloadCodec::decompress (const char *input, size_t length, char *output, size_t outputSize)
+{
+    if (!isCompressed(input, length)) {
+        return -1;
+    }
+
+    size_t in = 1;
+    size_t out = 0;
+
+    auto get = [input, length, &in] (uint8_t &c) -> bool {
+        if (in >= length) {
+            return false;
+        }
+        c = input[in++];
+        if (c == CODEC_ESCAPE) {
+            if (in >= length) {
+                return false;
+            }
+            c = input[in++] ^ 0x40;
+        }
+        return true;
+    };
+
+    uint8_t c;
+    while (in < length) {
+        if (!get(c)) {
+            return -1; // Truncated escape sequence
+        }
+        if (c >= 0x80) {
+            uint8_t low;
+            if (!get(low)) {
+                return -1;
+            }
+            size_t matchLength = ((c >> 3) & 0x0F) + MIN_MATCH;
+            size_t distance = (((c & 0x07) << 8) | low) + 1;
+            if (distance > DICTIONARY_SIZE + out || out + matchLength > outputSize) {
+                return -1;
+            }
+
+            // Byte by byte, as the match may overlap the output
+            size_t source = DICTIONARY_SIZE + out - distance;
+            for (size_t i = 0; i < matchLength; i++, source++) {
+                output[out++] = source < DICTIONARY_SIZE ? DICTIONARY[source] : output[source - DICTIONARY_SIZE];
+            }
+        } else {
+            if (c == CODEC_LITERAL) {
+                if (!get(c)) {
+                    return -1;
+                }
+            } else if (c < 0x20 || c == 0x7F) {
+                return -1;
+            }
+            if (out >= outputSize) {
+                return -1;
+            }
+            output[out++] = c;
+        }
+    }
+
+    return out;
+}
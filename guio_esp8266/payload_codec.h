@@ -0,0 +1,71 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Pass-through payload compression (static dictionary + LZ).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__PAYLOAD_CODEC_H
+#define GUIO_ESP8266__PAYLOAD_CODEC_H
+
+// NOTE: this module does not depend on Arduino, as it is shared with
+// the host library (libguio_host)
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Version of the format and of the dictionary; both sides must match
+#define PAYLOAD_CODEC_VERSION 1
+
+// Compressed payloads start with this character (which cannot start a
+// GUI-O command)
+#define PAYLOAD_CODEC_PREFIX '~'
+
+// Longest (uncompressed) message that is compressed
+#define PAYLOAD_CODEC_MAX_MESSAGE 512
+
+
+// Each message is compressed independently, with the static GUI-O
+// token dictionary acting as the preceding LZ window. The compressed
+// payload never contains NUL, CR, LF, XON or XOFF characters, so it
+// can be sent as a serial line or used as a C string.
+//
+// All state is kept in the object (approximately 4 kB); nothing is
+// allocated on heap.
+class PayloadCodec
+{
+public:
+    PayloadCodec ();
+
+    // Returns the length of compressed payload (including the prefix),
+    // or 0 if the message is not worth compressing (too long, or the
+    // result would not be smaller) or the output does not fit
+    size_t compress (const char *input, size_t length, char *output, size_t outputSize);
+
+    // Returns the length of decompressed message, or -1 if the payload
+    // is malformed or the output does not fit
+    static int decompress (const char *input, size_t length, char *output, size_t outputSize);
+
+    static bool isCompressed (const char *payload, size_t length)
+    {
+        return length > 0 && payload[0] == PAYLOAD_CODEC_PREFIX;
+    }
+
+protected:
+    static const uint16_t HASH_SIZE = 256;
+    static const uint16_t NO_POSITION = 0xFFFF;
+    static const uint16_t MAX_WINDOW = 1024 + PAYLOAD_CODEC_MAX_MESSAGE;
+
+    void insert (const char *data, uint16_t position);
+
+protected:
+    // Hash chains over the window (dictionary followed by the message)
+    uint16_t head[HASH_SIZE];
+    uint16_t dictionaryHead[HASH_SIZE]; // head after inserting the dictionary
+    uint16_t prev[MAX_WINDOW];
+};
+
+
+#endif
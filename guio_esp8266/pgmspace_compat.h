@@ -0,0 +1,39 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Program memory helpers for modules that are also built on host.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__PGMSPACE_COMPAT_H
+#define GUIO_ESP8266__PGMSPACE_COMPAT_H
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+#else
+
+// Host build (libguio_host harness); program memory is ordinary memory
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+#define memcmp_P memcmp
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define snprintf_P snprintf
+
+#endif
+
+#endif
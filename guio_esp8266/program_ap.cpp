@@ -75,32 +75,6 @@ void ProgramAp::setup ()
 }
 
 
-// A helper for copying a string field from JSON object
-static bool copy_string_parameter (const JsonObject &object, const char *fieldName, char *destBuffer, unsigned int destBufferSize, char *errorBuffer, unsigned int errorBufferSize)
-{
-    // Grab the field
-    JsonVariant field = object[fieldName];
-    if (!field) {
-        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' not found in request object!"), fieldName);
-        return false;
-    }
-
-    // Ensure it is a string
-    const char *value = field.as<const char *>();
-    if (!value) {
-        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' in request object is not a string!"), fieldName);
-        return false;
-    }
-
-    // Copy its contents (with overflow check)
-    if (snprintf(destBuffer, destBufferSize, "%s", value) >= destBufferSize) {
-        snprintf_P(errorBuffer, errorBufferSize, PSTR("Field '%s' in request object is too long!"), fieldName);
-        return false;
-    }
-
-    return true;
-}
-
 void ProgramAp::pairingRequestHandler (AsyncWebServerRequest *request, JsonVariant &json)
 {
     // Stop blinking LEDs...
@@ -114,59 +88,30 @@ void ProgramAp::pairingRequestHandler (AsyncWebServerRequest *request, JsonVaria
     GDBG_println();
 
     // Prepare response object
-    StaticJsonDocument<320> responseDocument;
+    StaticJsonDocument<384> responseDocument;
 
     // Parse request (and validate fields)
     parameters_t newParams;
     parameters_init(&newParams);
 
-    char errorMessage[256];
-
-    if (json.is<JsonObject>()) {
-        const JsonObject &requestObject = json.as<JsonObject>();
-
-        // Network SSID
-        if (!copy_string_parameter(requestObject, "networkSsid", newParams.networkSsid, sizeof(newParams.networkSsid), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
-
-        // Network password
-        if (!copy_string_parameter(requestObject, "networkPassword", newParams.networkPassword, sizeof(newParams.networkPassword), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
-
-        // MQTT host
-        if (!copy_string_parameter(requestObject, "mqttHostName", newParams.mqttHostName, sizeof(newParams.mqttHostName), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
-
-        // MQTT user name
-        if (!copy_string_parameter(requestObject, "mqttUserName", newParams.mqttUserName, sizeof(newParams.mqttUserName), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
-
-        // MQTT user password
-        if (!copy_string_parameter(requestObject, "mqttUserPassword", newParams.mqttUserPassword, sizeof(newParams.mqttUserPassword), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
-
-        // MQTT subscribe topic (NOTE: inverted meaning!)
-        if (!copy_string_parameter(requestObject, "subscribeTopic", newParams.publishTopic, sizeof(newParams.publishTopic), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
+    // MQTT connection settings are not part of the GUI-O pairing protocol;
+    // unless given in the request, keep the ones set via !MQTT command.
+    // They belong to the broker, so they are kept only if the broker
+    // does not change (or none was set before).
+    const char *hostName = json["mqttHostName"].as<const char *>();
+    if (!parameters.mqttHostName[0] || (hostName && strcmp(hostName, parameters.mqttHostName) == 0)) {
+        newParams.mqttPort = parameters.mqttPort;
+        newParams.mqttTls = parameters.mqttTls;
+        memcpy(newParams.mqttFingerprint, parameters.mqttFingerprint, sizeof(newParams.mqttFingerprint));
+    }
+    memcpy(newParams.mqttBackupBrokers, parameters.mqttBackupBrokers, sizeof(newParams.mqttBackupBrokers));
 
-        // MQTT publish topic (NOTE: inverted meaning!)
-        if (!copy_string_parameter(requestObject, "publishTopic", newParams.subscribeTopic, sizeof(newParams.subscribeTopic), errorMessage, sizeof(errorMessage))) {
-            goto end;
-        }
+    // Same for additional pass-through channels (set via !CHANNEL command)
+    memcpy(newParams.channels, parameters.channels, sizeof(newParams.channels));
 
-        // Mark as configured
-        newParams.configured = true;
-    } else {
-        snprintf_P(errorMessage, sizeof(errorMessage), PSTR("Request payload is not a JSON object!"));
-    }
+    char errorMessage[256];
 
-end:
+    pairing_parse_request(json, &newParams, errorMessage, sizeof(errorMessage));
 
     // If parameters are valid (configured flag is set), we succeeded
     if (newParams.configured) {
@@ -184,6 +129,8 @@ end:
         responseDocument["mqttUserPassword"] = newParams.mqttUserPassword;
         responseDocument["subscribeTopic"] = newParams.publishTopic; // inverted meaning!
         responseDocument["publishTopic"] = newParams.subscribeTopic; // inverted meaning!
+        responseDocument["mqttPort"] = newParams.mqttPort;
+        responseDocument["mqttTls"] = newParams.mqttTls;
     } else {
         responseDocument["pairingResponse"] = -1; // Failed; error message is stored in pairingResponseDetail
         responseDocument["pairingResponseDetail"] = errorMessage;
@@ -11,6 +11,7 @@
 #define GUIO_ESP8266__PROGRAM_AP_H
 
 #include "program_base.h"
+#include "pairing.h"
 
 #include <ESPAsyncWebServer.h>
 #include <AsyncJson.h>
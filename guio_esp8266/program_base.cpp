@@ -44,8 +44,34 @@ Program::Program (parameters_t &parameters)
         nullptr,
         nullptr
       ),
+      // Task for writing the captured traffic to flash
+      taskFlushCapture(
+        _GUIO_CAPTURE_FLUSH_INTERVAL*TASK_MILLISECOND,
+        TASK_FOREVER,
+        std::bind(&Program::taskFlushCaptureFcn, this),
+        &scheduler,
+        false,
+        nullptr,
+        nullptr
+      ),
       buttonStateChanged(false),
-      buttonPressTime(0)
+      buttonPressTime(0),
+      serialCommand(COMMAND_NONE),
+      serialArgs(nullptr),
+      flowInputPaused(false),
+      flowOutputPaused(false),
+      flowInputPauseStart(0),
+      flowOutputPauseStart(0),
+      flowInputPauses(0),
+      flowInputPauseTime(0),
+      flowOutputPauses(0),
+      flowOutputPauseTime(0),
+      serialOverruns(0),
+      replies(Serial, flowOutputPaused),
+      powerState(POWER_IDLE),
+      powerStateStart(0),
+      lastTraffic(0),
+      powerStats()
 {
 }
 
@@ -58,6 +84,9 @@ void Program::setup ()
     pinMode(_GUIO_AP_BUTTON, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(_GUIO_AP_BUTTON), std::bind(&Program::buttonPressIsr, this), CHANGE);
 
+    // Serial flow control
+    setupFlowControl();
+
     // Initialize device ID (guio_ + MAC); used as
     //  - SSID in AP mode
     //  - pairing device name in AP mode
@@ -66,6 +95,11 @@ void Program::setup ()
     uint8_t macAddr[6];
     WiFi.softAPmacAddress(macAddr);
     snprintf_P(deviceId, sizeof(deviceId), PSTR("guio_%02x%02x%02x%02x%02x%02x"), macAddr[0], macAddr[1], macAddr[2], macAddr[3], macAddr[4], macAddr[5]);
+
+    // Power management; start in idle state
+    powerStateStart = millis();
+    powerStats[powerState].entries++;
+    powerStateChanged();
 }
 
 
@@ -77,41 +111,259 @@ void Program::loop ()
         buttonStateChanged = false;
     }
 
-    // Schedule tasks
-    scheduler.execute();
+    // Power management
+    updatePowerState();
+
+    // Schedule tasks; time the idle runs, which (unless active) include
+    // the scheduler's sleep
+    uint32_t executeStart = micros();
+    if (scheduler.execute()) {
+        if (powerState == POWER_QUIET && !Serial.available()) {
+            delay(_GUIO_POWER_QUIET_SLEEP);
+        }
+
+        uint32_t duration = micros() - executeStart;
+        power_stats_t &stats = powerStats[powerState];
+        stats.idleRuns++;
+        stats.idleTime += duration;
+        if (duration > stats.idleTimeMax) {
+            stats.idleTimeMax = duration;
+        }
+    }
+
+    // Serial flow control; held-back responses are written once the
+    // back-end resumes our output
+    updateFlowControl();
+    replies.drain();
 
     // Serial input
     // Read in small batches to avoid potential flood from starving
     // task scheduler...
     if (Serial.available()) {
+        markTraffic();
         serialBatch = 0; // Reset batch counter
         while (Serial.available() && serialBatch < 32) {
             char c = Serial.read();
             serialBatch++;
 
-            if (c == '\n') {
-                // NULL terminate the buffer
-                serialBuffer[serialLen] = 0;
-                // Check if preceding character was \r; if it was, strip
-                // it away
-                if (serialLen > 0 && serialBuffer[serialLen-1] == '\r') {
-                    serialBuffer[--serialLen] = 0;
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_SOFTWARE
+            // XON/XOFF from back-end control our output
+            if (c == 0x13 || c == 0x11) {
+                bool paused = (c == 0x13);
+                if (paused && !flowOutputPaused) {
+                    flowOutputPauses++;
+                    flowOutputPauseStart = millis();
+                } else if (!paused && flowOutputPaused) {
+                    flowOutputPauseTime += millis() - flowOutputPauseStart;
+                }
+                flowOutputPaused = paused;
+                continue;
+            }
+#endif
+
+            if (serialFramer.feed(c)) {
+                serialLineComplete = micros();
+                char *line = serialFramer.line();
+                // Capture pass-through and command lines
+                if (line[0] == '$' || line[0] == '!') {
+                    capture.record(TRACE_SERIAL_IN, 0, (const uint8_t *)line, serialFramer.length());
                 }
                 // Process the line
+                serialCommand = command_parse(line, &serialArgs);
                 serialInputHandler();
-                // Reset buffer length
-                serialLen = 0;
-            } else {
-                // Read into buffer, truncate on overflow
-                if (serialLen < sizeof(serialBuffer) - 1) {
-                    serialBuffer[serialLen++] = c;
-                }
+                // Processing might have taken a while (e.g., publish)
+                updateFlowControl();
+            } else if (serialFramer.length() == 1) {
+                // First character of the line
+                serialLineStart = micros();
             }
         }
     }
 }
 
 
+void Program::setupFlowControl ()
+{
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_HARDWARE
+    // RTS is driven by software, based on fill level of the receive
+    // buffer (the UART's own RX flow control only considers its small
+    // hardware FIFO, which is continuously emptied by the driver).
+    // Asserted (LOW) = ready to receive.
+    pinMode(_GUIO_SERIAL_RTS_PIN, OUTPUT);
+    digitalWrite(_GUIO_SERIAL_RTS_PIN, LOW);
+
+    // CTS is handled by the UART itself; transmission is halted while
+    // CTS is de-asserted (HIGH)
+    pinMode(13, FUNCTION_4); // U0CTS
+    USC0(UART0) |= (1 << UCTXHFE);
+#elif _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_SOFTWARE
+    Serial.write(0x11); // XON
+#endif
+}
+
+void Program::updateFlowControl ()
+{
+    if (Serial.hasOverrun()) {
+        serialOverruns++;
+    }
+
+#if _GUIO_SERIAL_FLOW_CONTROL != _GUIO_FLOW_NONE
+    // Pause/resume the back-end, with hysteresis. Besides the unread
+    // input, the output that is waiting to be written (e.g., queued
+    // messages) counts towards the fill level, so that the back-end
+    // does not keep sending while we cannot keep up.
+    int fill = Serial.available() + flowBacklog();
+    if (!flowInputPaused && fill >= _GUIO_SERIAL_FLOW_HIGH) {
+        flowInputPaused = true;
+        flowInputPauses++;
+        flowInputPauseStart = millis();
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_HARDWARE
+        digitalWrite(_GUIO_SERIAL_RTS_PIN, HIGH);
+#else
+        Serial.write(0x13); // XOFF
+#endif
+    } else if (flowInputPaused && fill <= _GUIO_SERIAL_FLOW_LOW) {
+        flowInputPaused = false;
+        flowInputPauseTime += millis() - flowInputPauseStart;
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_HARDWARE
+        digitalWrite(_GUIO_SERIAL_RTS_PIN, LOW);
+#else
+        Serial.write(0x11); // XON
+#endif
+    }
+#endif
+
+#if _GUIO_SERIAL_FLOW_CONTROL == _GUIO_FLOW_HARDWARE
+    // Track CTS state for statistics and for holding back our output
+    bool paused = digitalRead(13) == HIGH;
+    if (paused && !flowOutputPaused) {
+        flowOutputPauses++;
+        flowOutputPauseStart = millis();
+    } else if (!paused && flowOutputPaused) {
+        flowOutputPauseTime += millis() - flowOutputPauseStart;
+    }
+    flowOutputPaused = paused;
+#endif
+}
+
+bool Program::serialOutputPaused () const
+{
+    return flowOutputPaused;
+}
+
+unsigned int Program::flowBacklog () const
+{
+    return replies.getUsed();
+}
+
+void Program::flowCommandHandler ()
+{
+    // Include ongoing pauses
+    uint32_t now = millis();
+    uint32_t inputPauseTime = flowInputPauseTime + (flowInputPaused ? now - flowInputPauseStart : 0);
+    uint32_t outputPauseTime = flowOutputPauseTime + (flowOutputPaused ? now - flowOutputPauseStart : 0);
+
+    // !FLOW <mode> <rx pauses> <rx pause time> <tx pauses> <tx pause time> <rx overruns> <dropped replies>
+    replies.printf_P(PSTR("!FLOW %u %u %u %u %u %u %u\r\n"), _GUIO_SERIAL_FLOW_CONTROL, flowInputPauses, inputPauseTime, flowOutputPauses, outputPauseTime, serialOverruns, replies.getDropped());
+}
+
+
+void Program::markTraffic ()
+{
+    lastTraffic = millis();
+#ifdef _GUIO_POWER_ADAPTIVE
+    setPowerState(POWER_ACTIVE);
+#endif
+}
+
+void Program::updatePowerState ()
+{
+#ifdef _GUIO_POWER_ADAPTIVE
+    // Only traffic can bring us out of quiet state (this also keeps us
+    // there if millis() wraps around)
+    uint32_t elapsed = millis() - lastTraffic;
+    if (powerState == POWER_ACTIVE && elapsed >= _GUIO_POWER_ACTIVE_TIME) {
+        setPowerState(POWER_IDLE);
+    } else if (powerState == POWER_IDLE && elapsed >= _GUIO_POWER_QUIET_TIME) {
+        setPowerState(POWER_QUIET);
+    }
+#endif
+}
+
+void Program::setPowerState (PowerState state)
+{
+    if (state == powerState) {
+        return;
+    }
+
+    uint32_t now = millis();
+    powerStats[powerState].time += now - powerStateStart;
+    powerStats[state].entries++;
+    powerStateStart = now;
+    powerState = state;
+
+    GDBG_print(F("Power state: "));
+    GDBG_println(state);
+
+    powerStateChanged();
+}
+
+void Program::powerStateChanged ()
+{
+    // Avoid idle sleep while traffic is ongoing; any sleep delays the
+    // processing of a burst
+    scheduler.allowSleep(powerState != POWER_ACTIVE);
+}
+
+bool Program::powerCommandHandler (const char *args)
+{
+    // !POWER [RESET]
+    while (*args == ' ') {
+        args++;
+    }
+
+    if (!*args) {
+        // Report only
+    } else if (strcmp_P(args, PSTR("RESET")) == 0) {
+        memset(powerStats, 0, sizeof(powerStats));
+        powerStats[powerState].entries = 1;
+        powerStateStart = millis();
+    } else {
+        return false;
+    }
+
+    static const char stateNames[POWER_STATES][7] PROGMEM = { "ACTIVE", "IDLE", "QUIET" };
+    static const uint16_t stateCurrents[POWER_STATES] = {
+        _GUIO_POWER_ACTIVE_CURRENT,
+        _GUIO_POWER_IDLE_CURRENT,
+        _GUIO_POWER_QUIET_CURRENT,
+    };
+
+    // Include ongoing state
+    uint32_t now = millis();
+    uint64_t totalTime = 0;
+    uint64_t totalCharge = 0; // mA * ms
+
+    for (uint8_t state = 0; state < POWER_STATES; state++) {
+        const power_stats_t &stats = powerStats[state];
+        uint32_t time = stats.time + (state == powerState ? now - powerStateStart : 0);
+        uint32_t idleTimeMean = stats.idleRuns ? stats.idleTime / stats.idleRuns : 0;
+
+        totalTime += time;
+        totalCharge += (uint64_t)time * stateCurrents[state];
+
+        // !POWER <state> <time> <entries> <idle runs> <mean idle run (us)> <max idle run (us)> <est. current (mA)>
+        replies.printf_P(PSTR("!POWER %S %u %u %u %u %u %u\r\n"), stateNames[state], time, stats.entries, stats.idleRuns, idleTimeMean, stats.idleTimeMax, stateCurrents[state]);
+    }
+
+    // !POWER NOW <state> <est. average current (0.1 mA)>
+    uint32_t averageCurrent = totalTime ? totalCharge * 10 / totalTime : 0;
+    replies.printf_P(PSTR("!POWER NOW %S %u\r\n"), stateNames[powerState], averageCurrent);
+
+    return true;
+}
+
+
 void Program::toggleLed (bool on)
 {
     // LOW = on, HIGH = off
@@ -134,6 +386,16 @@ void Program::taskBlinkLedFcn ()
     }
 }
 
+void Program::taskFlushCaptureFcn ()
+{
+    // Write the buffered records; once the capture has stopped (by
+    // command or due to the size limit), this also closes the file
+    capture.flush();
+    if (!capture.isActive()) {
+        taskFlushCapture.disable();
+    }
+}
+
 
 void Program::clearParametersInEeprom () const
 {
@@ -193,30 +455,131 @@ void Program::taskCheckButtonFcn ()
 bool Program::serialInputHandler ()
 {
     GDBG_print(F("Received line: "));
-    GDBG_println(serialBuffer);
-
-    if (serialBuffer[0] == '!') {
-        // Protocol commands
-        if (strcmp_P(serialBuffer, PSTR("!PING")) == 0) {
-            // Ping - FIXME: add state code
-            Serial.print(F("!PONG "));
-            Serial.println(statusCode);
-            return true;
-        } else if (strcmp_P(serialBuffer, PSTR("!REBOOT")) == 0) {
-            // Reboot in preferred mode
-            restartSystem();
-            return true;
-        } else if (strcmp_P(serialBuffer, PSTR("!REBOOT_AP")) == 0) {
-            parameters.force_ap = true; // set forced AP flag
-            writeParametersToEeprom(); // write to EEPROM
-            restartSystem(); // restart
-            return true;
-        } else if (strcmp_P(serialBuffer, PSTR("!CLEAR_PARAMS")) == 0) {
-            clearParametersInEeprom(); // clear EEPROM
-            restartSystem(); // restart
-            return true;
+    GDBG_println(serialFramer.line());
+
+    // Protocol commands
+    if (serialCommand == COMMAND_PING) {
+        // Ping - FIXME: add state code
+        replies.print(F("!PONG "));
+        replies.println(statusCode);
+        return true;
+    } else if (serialCommand == COMMAND_REBOOT) {
+        // Reboot in preferred mode
+        restartSystem();
+        return true;
+    } else if (serialCommand == COMMAND_REBOOT_AP) {
+        parameters.force_ap = true; // set forced AP flag
+        writeParametersToEeprom(); // write to EEPROM
+        restartSystem(); // restart
+        return true;
+    } else if (serialCommand == COMMAND_CLEAR_PARAMS) {
+        clearParametersInEeprom(); // clear EEPROM
+        restartSystem(); // restart
+        return true;
+    } else if (serialCommand == COMMAND_FLOW) {
+        flowCommandHandler();
+        return true;
+    } else if (serialCommand == COMMAND_POWER) {
+        if (!powerCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
         }
+        return true;
+    } else if (serialCommand == COMMAND_MQTT) {
+        if (!mqttCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    } else if (serialCommand == COMMAND_CAPTURE) {
+        if (!captureCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    } else if (serialCommand == COMMAND_BROKER) {
+        if (!brokerCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
     }
 
     return false; // Line not processed
 }
+
+bool Program::mqttCommandHandler (char *args)
+{
+    // !MQTT <port> <TLS|PLAIN> [fingerprint]
+    command_mqtt_args_t mqtt;
+    if (!command_parse_mqtt_args(args, &mqtt)) {
+        return false;
+    }
+
+    // Store; takes effect on next (re)start
+    parameters.mqttPort = mqtt.port;
+    parameters.mqttTls = mqtt.tls;
+    memcpy(parameters.mqttFingerprint, mqtt.fingerprint, sizeof(mqtt.fingerprint));
+    writeParametersToEeprom();
+
+    replies.print(F("!MQTT "));
+    replies.print(parameters.mqttPort);
+    replies.println(parameters.mqttTls ? F(" TLS") : F(" PLAIN"));
+
+    return true;
+}
+
+bool Program::brokerCommandHandler (char *args)
+{
+    // !BROKER <idx> [host[:port]]
+    command_broker_args_t broker;
+    if (!command_parse_broker_args(args, &broker)) {
+        return false;
+    }
+
+    auto &entry = parameters.mqttBackupBrokers[broker.index - 1];
+    strcpy(entry.hostName, broker.hostName);
+    entry.port = broker.port;
+
+    // Store; takes effect on next (re)start
+    writeParametersToEeprom();
+
+    replies.print(F("!BROKER "));
+    replies.print(broker.index);
+    replies.print(' ');
+    replies.print(entry.hostName);
+    replies.print(' ');
+    replies.println(entry.port);
+
+    return true;
+}
+
+bool Program::captureCommandHandler (const char *args)
+{
+    // !CAPTURE [START|STOP|DUMP]
+    while (*args == ' ') {
+        args++;
+    }
+
+    if (!*args) {
+        // Status only
+    } else if (strcmp_P(args, PSTR("START")) == 0) {
+        if (!capture.start()) {
+            return false;
+        }
+        taskFlushCapture.enable();
+    } else if (strcmp_P(args, PSTR("STOP")) == 0) {
+        capture.stop();
+    } else if (strcmp_P(args, PSTR("DUMP")) == 0) {
+        // The dump is too large to be held back; it fails while the
+        // back-end has paused our output, or while capture is active
+        if (serialOutputPaused()) {
+            return false;
+        }
+        replies.drain();
+        return capture.dump(Serial);
+    } else {
+        return false;
+    }
+
+    // !CAPTURE <ON|OFF> <records> <bytes written> <dropped records>
+    replies.printf_P(PSTR("!CAPTURE %s %u %u %u\r\n"), capture.isActive() ? "ON" : "OFF", capture.getRecords(), capture.getSize(), capture.getDropped());
+
+    return true;
+}
@@ -12,6 +12,10 @@
 
 #include "config.h"
 #include "parameters.h"
+#include "reply_buffer.h"
+#include "serial_framer.h"
+#include "command_parser.h"
+#include "trace_capture.h"
 
 #include <TaskSchedulerDeclarations.h>
 #include <ESP8266WiFi.h>
@@ -31,6 +35,16 @@ enum StatusCode
 };
 
 
+enum PowerState
+{
+    POWER_ACTIVE = 0, // recent traffic; no idle sleep
+    POWER_IDLE = 1, // default
+    POWER_QUIET = 2, // no traffic for a while; deeper sleep
+
+    POWER_STATES
+};
+
+
 class Program
 {
 public:
@@ -49,6 +63,23 @@ protected:
     void buttonPressHandler (unsigned int duration);
 
     void taskBlinkLedFcn ();
+    void taskFlushCaptureFcn ();
+
+    void setupFlowControl ();
+    void updateFlowControl ();
+    bool serialOutputPaused () const;
+    virtual unsigned int flowBacklog () const;
+    void flowCommandHandler ();
+
+    void markTraffic ();
+    void updatePowerState ();
+    void setPowerState (PowerState state);
+    virtual void powerStateChanged ();
+    bool powerCommandHandler (const char *args);
+
+    bool mqttCommandHandler (char *args);
+    bool brokerCommandHandler (char *args);
+    bool captureCommandHandler (const char *args);
 
     void clearParametersInEeprom () const;
     void writeParametersToEeprom () const;
@@ -70,15 +101,51 @@ protected:
     // Tasks
     Task taskBlinkLed;
     Task taskCheckButton;
+    Task taskFlushCapture;
 
     // Button handling
     volatile bool buttonStateChanged;
     unsigned int buttonPressTime;
 
     // Serial input
-    char serialBuffer[256]; // 255 + NULL
-    uint16_t serialLen;
+    SerialFramer serialFramer;
+    Command serialCommand; // command in current line (if any)
+    char *serialArgs; // arguments of the command
     uint8_t serialBatch;
+    uint32_t serialLineStart; // micros() when first character of line was read
+    uint32_t serialLineComplete; // micros() when line was completed
+
+    // Serial flow control
+    bool flowInputPaused; // back-end is paused by us (RTS/XOFF)
+    bool flowOutputPaused; // we are paused by back-end (CTS/XOFF)
+    uint32_t flowInputPauseStart;
+    uint32_t flowOutputPauseStart;
+    uint32_t flowInputPauses;
+    uint32_t flowInputPauseTime; // total (ms)
+    uint32_t flowOutputPauses;
+    uint32_t flowOutputPauseTime; // total (ms)
+    uint32_t serialOverruns;
+
+    // Command responses; held back while our output is paused
+    ReplyBuffer replies;
+
+    // Power management
+    struct power_stats_t
+    {
+        uint32_t time; // total time in state (ms)
+        uint32_t entries;
+        uint32_t idleRuns; // idle scheduler runs
+        uint64_t idleTime; // total duration of idle runs (us)
+        uint32_t idleTimeMax; // longest idle run (us)
+    };
+
+    PowerState powerState;
+    uint32_t powerStateStart; // millis() when state was entered
+    uint32_t lastTraffic; // millis() of last serial or MQTT traffic
+    power_stats_t powerStats[POWER_STATES];
+
+    // Traffic capture
+    TraceCapture capture;
 };
 
 
@@ -13,7 +13,22 @@
 ProgramSta::ProgramSta (parameters_t &parameters)
     : Program(parameters),
       wifiClient(),
+      wifiClientSecure(),
       mqttClient(),
+      brokers(),
+      currentBroker(0),
+      probeBroker(0),
+      mqttWasConnected(false),
+      probeClient(),
+      mqttConnectCount(0),
+      mqttConnectTime(0),
+      mqttConnectHeap(0),
+      traceRecords(false),
+      inboundTrace(),
+      codec(),
+      compressionMode(0),
+      compressStats(),
+      decompressStats(),
       // Task that checks and attempts to re-establish connection.
       taskCheckConnection(
         15*TASK_SECOND,
@@ -23,6 +38,17 @@ ProgramSta::ProgramSta (parameters_t &parameters)
         false,
         nullptr,
         nullptr
+      ),
+      // Task that measures latency of MQTT brokers, and switches to the
+      // preferred one.
+      taskProbeBrokers(
+        _GUIO_MQTT_PROBE_INTERVAL*TASK_MILLISECOND,
+        TASK_FOREVER,
+        std::bind(&ProgramSta::taskProbeBrokersFcn, this),
+        &scheduler,
+        false,
+        nullptr,
+        nullptr
       )
 {
 }
@@ -46,6 +72,20 @@ void ProgramSta::setup ()
     GDBG_print(F("MQTT host: "));
     GDBG_println(parameters.mqttHostName);
 
+    GDBG_print(F("MQTT port: "));
+    GDBG_print(parameters.mqttPort);
+    GDBG_println(parameters.mqttTls ? F(" (TLS)") : F(" (plain)"));
+
+    for (uint8_t broker = 1; broker < MQTT_BROKERS; broker++) {
+        if (!brokerHostName(broker)[0]) {
+            continue;
+        }
+        GDBG_print(F("MQTT backup host: "));
+        GDBG_print(brokerHostName(broker));
+        GDBG_print(':');
+        GDBG_println(brokerPort(broker));
+    }
+
     GDBG_print(F("MQTT user name: "));
     GDBG_println(parameters.mqttUserName);
 
@@ -58,6 +98,23 @@ void ProgramSta::setup ()
     GDBG_print(F("MQTT publish topic: "));
     GDBG_println(parameters.publishTopic);
 
+    for (uint8_t channel = 1; channel < _GUIO_CHANNELS; channel++) {
+        if (!channelSubscribeTopic(channel)[0]) {
+            continue;
+        }
+        GDBG_print(F("Channel "));
+        GDBG_print(channel);
+        GDBG_print(F(" subscribe/publish topic: "));
+        GDBG_print(channelSubscribeTopic(channel));
+        GDBG_print(F(" / "));
+        GDBG_println(channelPublishTopic(channel));
+    }
+
+    // Set up channel routing
+    for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+        channelMux.setTopic(channel, channelSubscribeTopic(channel));
+    }
+
     // Hostname
     if (false) {
         // FIXME: add support for setting hostname from EEPROM parameters
@@ -70,11 +127,25 @@ void ProgramSta::setup ()
     WiFi.begin(parameters.networkSsid, parameters.networkPassword);
 
     // Set up MQTT client
-    mqttClient.setClient(wifiClient);
-    mqttClient.setServer(parameters.mqttHostName, 1883);
+    if (parameters.mqttTls) {
+        setupTls();
+        mqttClient.setClient(wifiClientSecure);
+    } else {
+        mqttClient.setClient(wifiClient);
+    }
+    // With backup brokers, detect a lost connection sooner, so that
+    // failover is quick
+    // Decompressed messages can be longer than PubSubClient's default
+    // buffer (256 bytes), in which case publishing would fail
+    if (!mqttClient.setBufferSize(MQTT_BUFFER_SIZE)) {
+        GDBG_println(F("Failed to allocate MQTT buffer!"));
+    }
+    mqttClient.setKeepAlive(configuredBrokers() > 1 ? _GUIO_MQTT_FAILOVER_KEEPALIVE : _GUIO_MQTT_KEEPALIVE);
     mqttClient.setCallback(std::bind(&ProgramSta::mqttReceiveCallback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
     taskCheckConnection.enableDelayed(5*TASK_SECOND); // Schedule first check after 5 seconds
+    probeClient.setTimeout(_GUIO_MQTT_PROBE_TIMEOUT);
+    taskProbeBrokers.enableDelayed();
 
     // Set status
     statusCode = STATUS_STA_NOWIFI;
@@ -86,7 +157,26 @@ void ProgramSta::loop ()
 {
     Program::loop();
 
-    mqttClient.loop();
+    if (!mqttClient.loop() && mqttWasConnected) {
+        // Connection lost (e.g., broker missed keep-alive); fail over
+        // right away instead of waiting for the next periodic check
+        GDBG_println(F("MQTT connection lost!"));
+        mqttWasConnected = false;
+        if (WiFi.status() == WL_CONNECTED) {
+            markBrokerFailure(currentBroker);
+        }
+        taskCheckConnection.forceNextIteration();
+    }
+
+    // Forward (at most) one queued MQTT message to serial, unless the
+    // back-end asked us to pause
+    if (!serialOutputPaused()) {
+        channelMux.writeNext(Serial);
+    }
+
+    if (inboundTrace.active) {
+        updateInboundTrace();
+    }
 }
 
 
@@ -97,16 +187,28 @@ void ProgramSta::taskCheckConnectionFcn ()
         GDBG_println(WiFi.localIP());
 
         if (!mqttClient.connected()) {
-            // Try connecting again
-            if (mqttClient.connect(deviceId, parameters.mqttUserName, parameters.mqttUserPassword)) {
-                GDBG_print(F("MQTT client established connection! Subscribing to topic "));
-                GDBG_println(parameters.subscribeTopic);
+            // Try connecting again; on failure, the broker is marked as
+            // failed and next attempt fails over to the next one
+            uint8_t brokerCount = configuredBrokers();
+
+            bool connected = false;
+            for (uint8_t attempt = 0; attempt < brokerCount && !connected; attempt++) {
+                connected = connectMqtt();
+            }
+
+            if (connected) {
+                GDBG_println(F("MQTT client established connection! Subscribing to topics..."));
 
-                if (mqttClient.subscribe(parameters.subscribeTopic)) {
-                    GDBG_println(F("MQTT client subscribed to topic!"));
+                // Messages might have been lost while disconnected
+                for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+                    uiCache.invalidate(channel);
+                }
+
+                if (subscribeChannels()) {
+                    GDBG_println(F("MQTT client subscribed to topics!"));
                     statusCode = STATUS_STA_READY;
                 } else {
-                    GDBG_println(F("MQTT client failed to subscribe to topic!"));
+                    GDBG_println(F("MQTT client failed to subscribe to topics!"));
                     statusCode = STATUS_STA_NOSUB;
                     // FIXME: how to properly handle this? Disconnect?
                 }
@@ -139,30 +241,734 @@ void ProgramSta::taskCheckConnectionFcn ()
         taskBlinkLed.setInterval(TASK_SECOND);
         taskBlinkLed.enableIfNot();
     }
+
+    // Connection state might have changed
+    updateCheckConnectionInterval();
+}
+
+void ProgramSta::updateCheckConnectionInterval ()
+{
+    // Relaxed checks only while quiet and fully connected; otherwise,
+    // reconnection attempts should not be delayed
+    uint32_t interval = 15*TASK_SECOND;
+    if (powerState == POWER_QUIET && statusCode == STATUS_STA_READY) {
+        interval = _GUIO_POWER_QUIET_CHECK_INTERVAL*TASK_MILLISECOND;
+    }
+
+    // Changing the interval re-schedules the task
+    if (taskCheckConnection.getInterval() != interval) {
+        taskCheckConnection.setInterval(interval);
+    }
+}
+
+void ProgramSta::powerStateChanged ()
+{
+    Program::powerStateChanged();
+
+    // WiFi modem sleep; with longer listen interval, the radio skips
+    // DTIM beacons (and delays inbound messages) in favor of lower power
+    if (powerState == POWER_ACTIVE) {
+        WiFi.setSleepMode(WIFI_NONE_SLEEP);
+    } else if (powerState == POWER_IDLE) {
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+    } else {
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP, _GUIO_POWER_QUIET_LISTEN_INTERVAL);
+    }
+
+    updateCheckConnectionInterval();
+}
+
+void ProgramSta::setupTls ()
+{
+    if (parameters_has_fingerprint(&parameters)) {
+        wifiClientSecure.setFingerprint(parameters.mqttFingerprint);
+    } else {
+        GDBG_println(F("WARNING: MQTT broker fingerprint not set; certificate will not be verified!"));
+        wifiClientSecure.setInsecure();
+    }
+}
+
+bool ProgramSta::connectMqtt ()
+{
+    int broker = selectBroker();
+    if (broker < 0) {
+        return false;
+    }
+
+    broker_state_t &state = brokers[broker];
+    const char *hostName = brokerHostName(broker);
+    uint16_t port = brokerPort(broker);
+
+    GDBG_print(F("Connecting to MQTT broker "));
+    GDBG_print(hostName);
+    GDBG_print(':');
+    GDBG_println(port);
+
+    currentBroker = broker;
+    mqttClient.setServer(hostName, port);
+
+    if (parameters.mqttTls) {
+        // Reduce the TLS buffers if broker supports MFLN. This requires
+        // a connection to the broker, so it is done before first connect.
+        if (!state.mflnProbed) {
+            state.mflnSupported = BearSSL::WiFiClientSecure::probeMaxFragmentLength(hostName, port, _GUIO_TLS_RX_BUFFER);
+            state.mflnProbed = true;
+
+            GDBG_println(state.mflnSupported ? F("MQTT broker supports MFLN; using reduced TLS buffers.") : F("MQTT broker does not support MFLN; using default TLS buffers."));
+        }
+        if (state.mflnSupported) {
+            wifiClientSecure.setBufferSizes(_GUIO_TLS_RX_BUFFER, _GUIO_TLS_TX_BUFFER);
+        } else {
+            wifiClientSecure.setBufferSizes(16384, 512); // BearSSL defaults
+        }
+
+        // Keep the session parameters from the last successful handshake
+        // with this broker, so that reconnects can resume the session
+        // instead of performing a full (and expensive) handshake
+        wifiClientSecure.setSession(&state.tlsSession);
+    }
+
+    uint32_t heap = ESP.getFreeHeap();
+    uint32_t start = millis();
+
+    if (!mqttClient.connect(deviceId, parameters.mqttUserName, parameters.mqttUserPassword)) {
+        markBrokerFailure(broker);
+        return false;
+    }
+
+    mqttConnectCount++;
+    mqttConnectTime = millis() - start;
+    uint32_t heapAfter = ESP.getFreeHeap();
+    mqttConnectHeap = heap > heapAfter ? heap - heapAfter : 0; // heap may grow (e.g., freed TLS buffers)
+
+    state.connectTime = mqttConnectTime;
+    state.consecutiveFailures = 0;
+    state.lastFailure = 0;
+    mqttWasConnected = true;
+
+    // The connect time includes the TLS handshake and authentication,
+    // so it is not comparable to the latency of other brokers; measure
+    // the connected broker with the next probe instead
+    probeBroker = broker;
+
+    GDBG_print(F("MQTT connect took "));
+    GDBG_print(mqttConnectTime);
+    GDBG_print(F(" ms and "));
+    GDBG_print(mqttConnectHeap);
+    GDBG_println(F(" bytes of heap."));
+
+    return true;
+}
+
+
+const char *ProgramSta::brokerHostName (uint8_t broker) const
+{
+    return broker ? parameters.mqttBackupBrokers[broker - 1].hostName : parameters.mqttHostName;
+}
+
+uint16_t ProgramSta::brokerPort (uint8_t broker) const
+{
+    if (broker && parameters.mqttBackupBrokers[broker - 1].port) {
+        return parameters.mqttBackupBrokers[broker - 1].port;
+    }
+    return parameters.mqttPort;
+}
+
+uint8_t ProgramSta::configuredBrokers () const
+{
+    uint8_t count = 0;
+    for (uint8_t broker = 0; broker < MQTT_BROKERS; broker++) {
+        count += brokerHostName(broker)[0] ? 1 : 0;
+    }
+    return count;
+}
+
+bool ProgramSta::brokerHealthy (uint8_t broker) const
+{
+    const broker_state_t &state = brokers[broker];
+
+    if (!state.lastFailure || !state.consecutiveFailures) {
+        return true;
+    }
+
+    // Hold-off doubles with each consecutive failure (up to 16x), so
+    // that a broker that accepts connections but keeps failing does
+    // not cause frequent switching
+    uint8_t shift = state.consecutiveFailures > 5 ? 4 : state.consecutiveFailures - 1;
+    return millis() - state.lastFailure > ((uint32_t)_GUIO_MQTT_BROKER_HOLDOFF << shift);
+}
+
+void ProgramSta::updateBrokerRtt (uint8_t broker, uint32_t rtt)
+{
+    broker_state_t &state = brokers[broker];
+
+    rtt = rtt ? rtt : 1; // 0 = not measured
+    state.rtt = state.rtt ? (3*state.rtt + rtt) / 4 : rtt;
+
+    // Reachable again; no hold-off
+    state.consecutiveFailures = 0;
+    state.lastFailure = 0;
+}
+
+void ProgramSta::markBrokerFailure (uint8_t broker)
+{
+    broker_state_t &state = brokers[broker];
+
+    state.failures++;
+    if (state.consecutiveFailures < 255) {
+        state.consecutiveFailures++;
+    }
+    state.lastFailure = millis() | 1; // 0 = no failure
+}
+
+int ProgramSta::selectBroker () const
+{
+    // Healthy broker with lowest latency; a broker earlier in the list
+    // is preferred unless a later one is faster by more than the margin.
+    // Brokers that have not been measured yet (rtt = 0) rank below the
+    // measured ones, so that we never switch to a broker we know
+    // nothing about.
+    int best = -1;
+    for (uint8_t broker = 0; broker < MQTT_BROKERS; broker++) {
+        if (!brokerHostName(broker)[0] || !brokerHealthy(broker)) {
+            continue;
+        }
+
+        uint32_t rtt = brokers[broker].rtt;
+        if (best < 0) {
+            best = broker;
+        } else if (!rtt) {
+            continue;
+        } else if (!brokers[best].rtt || rtt + _GUIO_MQTT_BROKER_MARGIN < brokers[best].rtt) {
+            best = broker;
+        }
+    }
+
+    if (best >= 0) {
+        return best;
+    }
+
+    // All brokers failed recently; retry the one that failed longest ago
+    uint32_t now = millis();
+    for (uint8_t broker = 0; broker < MQTT_BROKERS; broker++) {
+        if (!brokerHostName(broker)[0]) {
+            continue;
+        }
+        if (best < 0 || now - brokers[broker].lastFailure > now - brokers[best].lastFailure) {
+            best = broker;
+        }
+    }
+
+    return best;
+}
+
+void ProgramSta::taskProbeBrokersFcn ()
+{
+    if (WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+
+    // The probe blocks the loop (DNS lookup and TCP connect, up to
+    // _GUIO_MQTT_PROBE_TIMEOUT), during which the serial receive buffer
+    // might overflow; probe only while the serial link is idle
+    if (millis() - lastTraffic < _GUIO_POWER_ACTIVE_TIME || Serial.available()) {
+        return;
+    }
+
+    // Probe one broker per iteration, to keep the loop responsive
+    uint8_t broker = probeBroker;
+    probeBroker = (probeBroker + 1) % MQTT_BROKERS;
+
+    const char *hostName = brokerHostName(broker);
+    if (!hostName[0]) {
+        return;
+    }
+
+    // Latency is estimated from duration of TCP handshake, which is
+    // available also for brokers we are not connected to (PubSubClient
+    // does not expose its PINGREQ/PINGRESP timing). The broker we are
+    // connected to is probed the same way, so that the latencies are
+    // comparable.
+    uint32_t start = millis();
+    bool reachable = probeClient.connect(hostName, brokerPort(broker));
+    uint32_t rtt = millis() - start;
+    probeClient.stop();
+
+    if (reachable) {
+        updateBrokerRtt(broker, rtt);
+    } else if (broker != currentBroker || !mqttClient.connected()) {
+        markBrokerFailure(broker); // connection loss is detected via keep-alive
+    }
+
+    GDBG_print(F("MQTT broker "));
+    GDBG_print(hostName);
+    GDBG_print(reachable ? F(" RTT: ") : F(" unreachable; RTT: "));
+    GDBG_println(brokers[broker].rtt);
+
+    // Switch to the preferred broker (e.g., when primary recovers);
+    // subscriptions are re-established by the connection task. The
+    // broker we are connected to must be measured first.
+    if (mqttClient.connected() && brokers[currentBroker].rtt) {
+        int preferred = selectBroker();
+        if (preferred >= 0 && preferred != currentBroker) {
+            GDBG_print(F("Switching to preferred MQTT broker "));
+            GDBG_println(brokerHostName(preferred));
+
+            mqttWasConnected = false;
+            mqttClient.disconnect();
+            taskCheckConnection.forceNextIteration();
+        } else {
+            GDBG_print(F("Staying with MQTT broker "));
+            GDBG_print(brokerHostName(currentBroker));
+            GDBG_print(F("; RTT: "));
+            GDBG_println(brokers[currentBroker].rtt);
+        }
+    }
+}
+
+void ProgramSta::brokerStatsCommandHandler ()
+{
+    // One line per broker: !BROKERS <idx> <host> <port> <active> <healthy> <rtt> <connect time> <failures>
+    for (uint8_t broker = 0; broker < MQTT_BROKERS; broker++) {
+        const char *hostName = brokerHostName(broker);
+        if (!hostName[0]) {
+            continue;
+        }
+        const broker_state_t &state = brokers[broker];
+        replies.printf_P(PSTR("!BROKERS %u %s %u %u %u %u %u %u\r\n"), broker, hostName, brokerPort(broker), mqttClient.connected() && broker == currentBroker, brokerHealthy(broker), state.rtt, state.connectTime, state.failures);
+    }
+}
+
+
+bool ProgramSta::subscribeChannels ()
+{
+    bool success = true;
+
+    for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+        const char *topic = channelSubscribeTopic(channel);
+        if (!topic[0]) {
+            continue; // unused channel
+        }
+
+        GDBG_print(F("Subscribing to topic "));
+        GDBG_println(topic);
+
+        if (!mqttClient.subscribe(topic)) {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+bool ProgramSta::publish (uint8_t channel, const char *payload)
+{
+    unsigned int length = strlen(payload);
+
+    capture.record(TRACE_MQTT_OUT, channel, (const uint8_t *)payload, length);
+
+    return mqttClient.publish(channelPublishTopic(channel), (const uint8_t *)payload, length);
+}
+
+unsigned int ProgramSta::flowBacklog () const
+{
+    return Program::flowBacklog() + channelMux.getQueuedBytes();
+}
+
+const char *ProgramSta::channelSubscribeTopic (uint8_t channel) const
+{
+    return channel ? parameters.channels[channel - 1].subscribeTopic : parameters.subscribeTopic;
 }
 
+const char *ProgramSta::channelPublishTopic (uint8_t channel) const
+{
+    return channel ? parameters.channels[channel - 1].publishTopic : parameters.publishTopic;
+}
+
+
 void ProgramSta::mqttReceiveCallback (char *topic, byte *payload, unsigned int length)
 {
+    uint32_t receiveTime = micros();
+
+    markTraffic();
+
     GDBG_print(F("Received "));
     GDBG_print(length);
     GDBG_print(F(" bytes from MQTT topic "));
     GDBG_println(topic);
 
+    int channel = channelMux.lookupTopic(topic);
+    if (channel < 0) {
+        GDBG_println(F("Topic does not belong to any channel!"));
+        return;
+    }
+
     // Strip trailing newline character(s) to avoid duplication (we
     // forward the line with added CRLF)
     while (length > 0 && (payload[length-1] == '\n' || payload[length-1] == '\r')) {
         length--;
     }
 
+    // Compressed payload from a compression-aware peer
+    if (PayloadCodec::isCompressed((const char *)payload, length)) {
+        const char *plain = decompressPayload((const char *)payload, length);
+        if (!plain) {
+            GDBG_println(F("Malformed compressed message!"));
+            return;
+        }
+        payload = (byte *)plain;
+    }
+
     GDBG_print(F("Message length: "));
     GDBG_println(length);
 
-    // Write payload to serial as a pass-through message
-    Serial.print('$');
-    for (unsigned int i = 0; i < length; i++) {
-        Serial.print((char)(payload[i]));
+    capture.record(TRACE_MQTT_IN, channel, payload, length);
+
+    // Front-end (re)initialization; if the screen is cached, rebuild it
+    // from the cache instead of involving the back-end
+    if (length >= 5 && memcmp_P(payload, PSTR("@init"), 5) == 0) {
+        if (uiCache.canReplay(channel, payload, length)) {
+            GDBG_println(F("Replaying cached screen..."));
+            // NOTE: publishing reuses the client's buffer, so payload
+            // must not be accessed after this point
+            uiCache.replay(channel, [this, channel] (const char *line) {
+                publish(channel, line);
+            });
+            return;
+        }
+        uiCache.storeInit(channel, payload, length);
+    } else {
+        // Widget event; the front-end state of the widget has changed
+        uiCache.processIncoming(channel, payload, length);
+    }
+
+    if (compressionMode & COMPRESS_SERIAL) {
+        payload = (byte *)compressPayload((const char *)payload, length);
+    }
+
+    // Queue the payload; it is written to serial as a pass-through
+    // message from the loop, in fair order with respect to other
+    // channels
+    if (!channelMux.enqueue(channel, payload, length)) {
+        GDBG_println(F("Cannot forward message - channel queue is full!"));
+        return;
+    }
+
+    if (!inboundTrace.active && latencyTracer.sample()) {
+        inboundTrace.active = true;
+        inboundTrace.written = false;
+        inboundTrace.id = latencyTracer.getTraceId();
+        inboundTrace.channel = channel;
+        inboundTrace.txTarget = channelMux.getStats(channel).txMessages + channelMux.getQueuedMessages(channel);
+        inboundTrace.receiveTime = receiveTime;
+    }
+}
+
+
+void ProgramSta::traceOutbound (uint8_t channel, const char *payload, uint32_t dispatchTime)
+{
+    uint32_t publishTime = micros();
+    uint16_t id = latencyTracer.getTraceId();
+
+    uint32_t rx = serialLineComplete - serialLineStart;
+    uint32_t dispatch = dispatchTime - serialLineComplete;
+    uint32_t publish = publishTime - dispatchTime;
+
+    latencyTracer.addSample(HOP_SERIAL_RX, rx);
+    latencyTracer.addSample(HOP_DISPATCH, dispatch);
+    latencyTracer.addSample(HOP_PUBLISH, publish);
+
+    // Side topic with bridge timestamps, so that the receiving side can
+    // also account for the broker hop. The record is published after the
+    // message, but the two may be delivered out of order (or the message
+    // dropped), so the record identifies the message by its sequence
+    // number on the channel and FNV-1a hash of its (uncompressed) payload:
+    // <id> <seq> <hash> <start> <complete> <dispatch> <publish>
+    uint32_t hash = 2166136261u;
+    for (const char *c = payload; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+
+    char topic[64];
+    char message[80];
+    snprintf_P(topic, sizeof(topic), PSTR("%s/trace"), channelPublishTopic(channel));
+    snprintf_P(message, sizeof(message), PSTR("%u %u %08x %u %u %u %u"), id, channelMux.getStats(channel).rxMessages, hash, serialLineStart, serialLineComplete, dispatchTime, publishTime);
+    mqttClient.publish(topic, message);
+
+    if (traceRecords) {
+        // !TRACEREC <id> OUT <ch> <serial rx> <dispatch> <publish>
+        replies.printf_P(PSTR("!TRACEREC %u OUT %u %u %u %u\r\n"), id, channel, rx, dispatch, publish);
+    }
+}
+
+void ProgramSta::updateInboundTrace ()
+{
+    if (!inboundTrace.written) {
+        // Written once the channel's tx counter reaches the target (this
+        // is checked right after each write)
+        if ((int32_t)(channelMux.getStats(inboundTrace.channel).txMessages - inboundTrace.txTarget) >= 0) {
+            inboundTrace.writeTime = micros();
+            inboundTrace.written = true;
+            inboundTrace.txWritten = channelMux.getWrittenBytes();
+        }
+    }
+
+    // The message is transmitted once the UART TX FIFO holds no more
+    // than the bytes written after it; under continuous traffic, the
+    // FIFO never drains completely. Other serial output (e.g., command
+    // responses) is not accounted for, which can only delay the end
+    // of the measurement.
+    bool transmitted = false;
+    if (inboundTrace.written) {
+        uint32_t level = UART_TX_FIFO_SIZE - Serial.availableForWrite();
+        transmitted = level <= channelMux.getWrittenBytes() - inboundTrace.txWritten;
+    }
+
+    if (!transmitted) {
+        // Not written (e.g., the channel queue was dropped) or held by
+        // flow control for too long; give up on this message
+        if (micros() - inboundTrace.receiveTime > _GUIO_TRACE_TIMEOUT * 1000UL) {
+            GDBG_println(F("Abandoning inbound trace!"));
+            inboundTrace.active = false;
+        }
+        return;
+    }
+
+    uint32_t queue = inboundTrace.writeTime - inboundTrace.receiveTime;
+    uint32_t tx = micros() - inboundTrace.writeTime;
+
+    latencyTracer.addSample(HOP_QUEUE, queue);
+    latencyTracer.addSample(HOP_SERIAL_TX, tx);
+
+    if (traceRecords) {
+        // !TRACEREC <id> IN <ch> <queue> <serial tx>
+        replies.printf_P(PSTR("!TRACEREC %u IN %u %u %u\r\n"), inboundTrace.id, inboundTrace.channel, queue, tx);
+    }
+
+    inboundTrace.active = false;
+}
+
+bool ProgramSta::traceCommandHandler (const char *args)
+{
+    // !TRACE [ON [interval] [REC]|OFF|RESET]
+    while (*args == ' ') {
+        args++;
+    }
+
+    if (!*args) {
+        latencyTracer.dump(replies);
+        return true;
+    } else if (strncmp_P(args, PSTR("ON"), 2) == 0 && (args[2] == ' ' || !args[2])) {
+        const char *option = args + 2;
+        while (*option == ' ') {
+            option++;
+        }
+
+        unsigned long interval = _GUIO_TRACE_INTERVAL;
+        if (*option >= '0' && *option <= '9') {
+            char *end;
+            interval = strtoul(option, &end, 10);
+            if (*end && *end != ' ') {
+                return false;
+            }
+            option = end;
+            while (*option == ' ') {
+                option++;
+            }
+        }
+        if (interval == 0 || interval > 65535) {
+            return false;
+        }
+
+        // Per-message records on serial only if asked for
+        bool records = false;
+        if (strcmp_P(option, PSTR("REC")) == 0) {
+            records = true;
+        } else if (*option) {
+            return false;
+        }
+
+        latencyTracer.setEnabled(true, interval);
+        traceRecords = records;
+    } else if (strcmp_P(args, PSTR("OFF")) == 0) {
+        latencyTracer.setEnabled(false, 1);
+        traceRecords = false;
+        inboundTrace.active = false;
+    } else if (strcmp_P(args, PSTR("RESET")) == 0) {
+        latencyTracer.reset();
+    } else {
+        return false;
+    }
+
+    if (!latencyTracer.isEnabled()) {
+        replies.println(F("!TRACE OFF"));
+    } else {
+        replies.println(traceRecords ? F("!TRACE ON REC") : F("!TRACE ON"));
+    }
+
+    return true;
+}
+
+
+const char *ProgramSta::compressPayload (const char *payload, unsigned int &length)
+{
+    uint32_t start = micros();
+    size_t compressedLength = codec.compress(payload, length, encodeBuffer, sizeof(encodeBuffer));
+    compressStats.time += micros() - start;
+
+    // Sent as-is if compression does not pay off; still accounted for
+    compressStats.plainBytes += length;
+    if (!compressedLength) {
+        compressStats.codedBytes += length;
+        return payload;
+    }
+    compressStats.codedBytes += compressedLength;
+
+    length = compressedLength;
+    return encodeBuffer;
+}
+
+const char *ProgramSta::decompressPayload (const char *payload, unsigned int &length)
+{
+    uint32_t start = micros();
+    int plainLength = PayloadCodec::decompress(payload, length, decodeBuffer, sizeof(decodeBuffer) - 1);
+    decompressStats.time += micros() - start;
+
+    if (plainLength < 0) {
+        return nullptr;
+    }
+
+    decompressStats.codedBytes += length;
+    decompressStats.plainBytes += plainLength;
+
+    decodeBuffer[plainLength] = 0;
+    length = plainLength;
+    return decodeBuffer;
+}
+
+bool ProgramSta::compressCommandHandler (const char *args)
+{
+    // !COMPRESS [OFF|SERIAL|MQTT|BOTH [version]|STATS]
+    command_compress_args_t compress;
+    if (!command_parse_compress_args(args, &compress)) {
+        return false;
+    }
+
+    if (compress.action == COMPRESS_ACTION_STATS) {
+        // !COMPRESS STATS <plain> <coded> <ratio (%)> <us/kB> <coded> <plain> <us/kB>
+        const codec_stats_t &c = compressStats;
+        const codec_stats_t &d = decompressStats;
+        replies.printf_P(PSTR("!COMPRESS STATS %u %u %u %u %u %u %u\r\n"),
+            c.plainBytes, c.codedBytes, c.plainBytes ? (uint32_t)((uint64_t)c.codedBytes * 100 / c.plainBytes) : 100, c.plainBytes ? (uint32_t)((uint64_t)c.time * 1024 / c.plainBytes) : 0,
+            d.codedBytes, d.plainBytes, d.plainBytes ? (uint32_t)((uint64_t)d.time * 1024 / d.plainBytes) : 0);
+        return true;
+    } else if (compress.action == COMPRESS_ACTION_SET) {
+        // The requesting side may give its codec version; in case of a
+        // mismatch, compression is turned off (and our version reported)
+        if (compress.hasVersion && compress.version != PAYLOAD_CODEC_VERSION) {
+            compress.mode = 0;
+        }
+        // Messages published to MQTT are not compressed, as there is
+        // no way (yet) to negotiate the codec with the MQTT peer
+        if (compress.mode & COMPRESS_MQTT) {
+            return false;
+        }
+        compressionMode = compress.mode;
+    }
+
+    // !COMPRESS <mode> <version>
+    static const char MODE_NAMES[4][7] PROGMEM = { "OFF", "SERIAL", "MQTT", "BOTH" };
+    char name[sizeof(MODE_NAMES[0])];
+    strcpy_P(name, MODE_NAMES[compressionMode]);
+    replies.printf_P(PSTR("!COMPRESS %s %u\r\n"), name, PAYLOAD_CODEC_VERSION);
+
+    return true;
+}
+
+
+bool ProgramSta::channelCommandHandler (char *args)
+{
+    // !CHANNEL <ch> [<subscribeTopic> <publishTopic>]
+    command_channel_args_t request;
+    if (!command_parse_channel_args(args, &request)) {
+        return false;
+    }
+    uint8_t channel = request.channel;
+    const char *subscribeTopic = request.subscribeTopic;
+    const char *publishTopic = request.publishTopic;
+
+    auto &entry = parameters.channels[channel - 1];
+
+    // Apply the change to live connection
+    if (mqttClient.connected()) {
+        if (entry.subscribeTopic[0]) {
+            mqttClient.unsubscribe(entry.subscribeTopic);
+        }
+        if (subscribeTopic[0] && !mqttClient.subscribe(subscribeTopic)) {
+            statusCode = STATUS_STA_NOSUB;
+        }
+    }
+
+    strcpy(entry.subscribeTopic, subscribeTopic);
+    strcpy(entry.publishTopic, publishTopic);
+    channelMux.setTopic(channel, entry.subscribeTopic);
+
+    writeParametersToEeprom();
+
+    replies.print(F("!CHANNEL "));
+    replies.print(channel);
+    replies.print(' ');
+    replies.print(entry.subscribeTopic);
+    replies.print(' ');
+    replies.println(entry.publishTopic);
+
+    return true;
+}
+
+bool ProgramSta::cacheCommandHandler (char *args)
+{
+    // !CACHE <ch> [ON|OFF|REPLAY]
+    char *saveptr;
+    const char *channelArg = strtok_r(args, " ", &saveptr);
+    const char *action = strtok_r(nullptr, " ", &saveptr);
+
+    if (!channelArg || channelArg[0] < '0' || channelArg[0] > '9' || channelArg[1] || channelArg[0] - '0' >= _GUIO_CHANNELS) {
+        return false;
+    }
+    uint8_t channel = channelArg[0] - '0';
+
+    if (!action) {
+        // Query only
+    } else if (strcmp_P(action, PSTR("ON")) == 0) {
+        uiCache.setEnabled(channel, true);
+    } else if (strcmp_P(action, PSTR("OFF")) == 0) {
+        uiCache.setEnabled(channel, false);
+    } else if (strcmp_P(action, PSTR("REPLAY")) == 0) {
+        const char *topic = channelPublishTopic(channel);
+        if (!mqttClient.connected() || !topic[0]) {
+            return false;
+        }
+        if (!uiCache.replay(channel, [this, channel] (const char *line) { publish(channel, line); })) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    // !CACHE <ch> <ON|OFF> <used bytes> <suppressed> <replayed>
+    replies.printf_P(PSTR("!CACHE %u %s %u %u %u\r\n"), channel, uiCache.isEnabled(channel) ? "ON" : "OFF", uiCache.getUsed(), uiCache.getSuppressed(channel), uiCache.getReplayed(channel));
+
+    return true;
+}
+
+void ProgramSta::channelStatsCommandHandler ()
+{
+    // One line per channel: !CHSTATS <ch> <rx msgs> <rx bytes> <tx msgs> <tx bytes> <tx dropped> <rx dropped>
+    for (uint8_t channel = 0; channel < _GUIO_CHANNELS; channel++) {
+        const channel_stats_t &stats = channelMux.getStats(channel);
+        replies.printf_P(PSTR("!CHSTATS %u %u %u %u %u %u %u\r\n"), channel, stats.rxMessages, stats.rxBytes, stats.txMessages, stats.txBytes, stats.txDropped, stats.rxDropped);
     }
-    Serial.println();
 }
 
 
@@ -173,13 +979,84 @@ bool ProgramSta::serialInputHandler ()
         return true;
     }
 
-    // ... then check if it is a pass-through message
-    if (serialBuffer[0] == '$') {
-        if (mqttClient.connected()) {
-            // Publish the message, skipping the pass-through character
-            mqttClient.publish(parameters.publishTopic, serialBuffer + 1);
+    // ... then check for STA-specific commands...
+    if (serialCommand == COMMAND_CHANNEL) {
+        if (!channelCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    } else if (serialCommand == COMMAND_CHSTATS) {
+        channelStatsCommandHandler();
+        return true;
+    } else if (serialCommand == COMMAND_MQTTSTATS) {
+        // !MQTTSTATS <connects> <last connect time (ms)> <last connect heap usage> <free heap>
+        replies.printf_P(PSTR("!MQTTSTATS %u %u %u %u\r\n"), mqttConnectCount, mqttConnectTime, mqttConnectHeap, ESP.getFreeHeap());
+        return true;
+    } else if (serialCommand == COMMAND_TRACE) {
+        if (!traceCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    } else if (serialCommand == COMMAND_BROKERS) {
+        brokerStatsCommandHandler();
+        return true;
+    } else if (serialCommand == COMMAND_CACHE) {
+        if (!cacheCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    } else if (serialCommand == COMMAND_COMPRESS) {
+        if (!compressCommandHandler(serialArgs)) {
+            replies.println(F("!ERROR"));
+        }
+        return true;
+    }
+
+    // ... and finally, check if it is a pass-through message
+    const char *payload;
+    int channel = ChannelMux::parseTag(serialFramer.line(), &payload);
+    if (channel < 0) {
+        return false;
+    }
+
+    uint32_t dispatchTime = micros();
+
+    // Compressed lines are accepted regardless of the negotiated mode
+    if (payload[0] == PAYLOAD_CODEC_PREFIX) {
+        unsigned int length = strlen(payload);
+        payload = decompressPayload(payload, length);
+        if (!payload) {
+            GDBG_println(F("Malformed compressed message!"));
+            return true;
+        }
+    }
+
+    const char *topic = channelPublishTopic(channel);
+    if (!topic[0]) {
+        GDBG_println(F("Cannot forward message - channel not configured!"));
+    } else if (mqttClient.connected()) {
+        // Drop updates that would not change the front-end's state
+        if (!uiCache.processOutgoing(channel, payload)) {
+            GDBG_println(F("Redundant update - not forwarding!"));
+            return true;
+        }
+
+        // Publish the message, skipping the pass-through tag
+        if (publish(channel, payload)) {
+            channelMux.countReceived(channel, strlen(payload));
+            if (latencyTracer.sample()) {
+                traceOutbound(channel, payload, dispatchTime);
+            }
         } else {
-            GDBG_println(F("Cannot forward message - MQTT client not connected!"));
+            GDBG_println(F("Cannot forward message - publish failed!"));
+            channelMux.countDropped(channel);
+            uiCache.invalidate(channel); // front-end state is unknown
         }
+    } else {
+        GDBG_println(F("Cannot forward message - MQTT client not connected!"));
+        channelMux.countDropped(channel);
+        uiCache.invalidate(channel); // front-end state is unknown
     }
+
+    return true;
 }
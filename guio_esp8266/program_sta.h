@@ -11,6 +11,10 @@
 #define GUIO_ESP8266__PROGRAM_STA_H
 
 #include "program_base.h"
+#include "channel_mux.h"
+#include "ui_cache.h"
+#include "latency_tracer.h"
+#include "payload_codec.h"
 
 #include <PubSubClient.h>
 
@@ -23,19 +27,124 @@ public:
     void setup () override;
     void loop () override;
     bool serialInputHandler () override;
+    unsigned int flowBacklog () const override;
 
 protected:
     void taskCheckConnectionFcn ();
+    void updateCheckConnectionInterval ();
+    void powerStateChanged () override;
+    void taskProbeBrokersFcn ();
 
     void mqttReceiveCallback (char *topic, byte *payload, unsigned int length);
 
+    const char *channelSubscribeTopic (uint8_t channel) const;
+    const char *channelPublishTopic (uint8_t channel) const;
+    bool subscribeChannels ();
+    bool publish (uint8_t channel, const char *payload);
+
+    bool channelCommandHandler (char *args);
+    void channelStatsCommandHandler ();
+    bool cacheCommandHandler (char *args);
+
+    void setupTls ();
+    bool connectMqtt ();
+
+    const char *brokerHostName (uint8_t broker) const;
+    uint16_t brokerPort (uint8_t broker) const;
+    uint8_t configuredBrokers () const;
+    bool brokerHealthy (uint8_t broker) const;
+    int selectBroker () const;
+    void updateBrokerRtt (uint8_t broker, uint32_t rtt);
+    void markBrokerFailure (uint8_t broker);
+    void brokerStatsCommandHandler ();
+
+    void traceOutbound (uint8_t channel, const char *payload, uint32_t dispatchTime);
+    void updateInboundTrace ();
+    bool traceCommandHandler (const char *args);
+
+    const char *compressPayload (const char *payload, unsigned int &length);
+    const char *decompressPayload (const char *payload, unsigned int &length);
+    bool compressCommandHandler (const char *args);
+
 protected:
     char mqttClientId[20]; // guio_MAC
 
     WiFiClient wifiClient;
+    BearSSL::WiFiClientSecure wifiClientSecure;
     PubSubClient mqttClient;
 
+    // MQTT packet buffer: fixed header (up to 5 bytes), topic (with its
+    // 16-bit length) and the longest (decompressed) payload
+    static const uint16_t MQTT_BUFFER_SIZE = 5 + 2 + sizeof(parameters_t::publishTopic) + PAYLOAD_CODEC_MAX_MESSAGE;
+
+    // MQTT brokers; 0 = primary, 1 .. = backup
+    static const uint8_t MQTT_BROKERS = 1 + _GUIO_MQTT_BACKUP_BROKERS;
+
+    struct broker_state_t
+    {
+        uint32_t rtt; // smoothed TCP round-trip time (ms); 0 = not measured
+        uint32_t connectTime; // duration of last successful connect (ms)
+        uint32_t failures; // failed connects and lost connections
+        uint8_t consecutiveFailures;
+        uint32_t lastFailure; // millis() of last failure; 0 = none
+        bool mflnProbed;
+        bool mflnSupported;
+        BearSSL::Session tlsSession; // for TLS session resumption
+    };
+
+    broker_state_t brokers[MQTT_BROKERS];
+    uint8_t currentBroker;
+    uint8_t probeBroker;
+    bool mqttWasConnected;
+    WiFiClient probeClient;
+
+    // MQTT connection statistics
+    uint32_t mqttConnectCount;
+    uint32_t mqttConnectTime; // duration of last successful connect (ms)
+    uint32_t mqttConnectHeap; // heap used by last successful connect (bytes)
+
+    ChannelMux channelMux;
+    UiCache uiCache;
+
+    // Latency tracing
+    LatencyTracer latencyTracer;
+    bool traceRecords; // !TRACEREC lines requested by the back-end
+
+    struct
+    {
+        bool active;
+        bool written;
+        uint16_t id;
+        uint8_t channel;
+        uint32_t txTarget; // channel's tx message count once the message is written
+        uint32_t txWritten; // bytes written by the channel mux once the message is written
+        uint32_t receiveTime;
+        uint32_t writeTime;
+    } inboundTrace; // at most one MQTT -> serial message is traced at a time
+
+    // Payload compression
+    enum
+    {
+        COMPRESS_SERIAL = 1 << 0, // messages written to serial
+        COMPRESS_MQTT = 1 << 1, // messages published to MQTT (not supported)
+    };
+
+    struct codec_stats_t
+    {
+        uint32_t plainBytes;
+        uint32_t codedBytes;
+        uint32_t time; // total (us)
+    };
+
+    PayloadCodec codec;
+    uint8_t compressionMode;
+    codec_stats_t compressStats;
+    codec_stats_t decompressStats;
+    char encodeBuffer[PAYLOAD_CODEC_MAX_MESSAGE];
+    char decodeBuffer[PAYLOAD_CODEC_MAX_MESSAGE + 1];
+
     Task taskCheckConnection;
+    Task taskProbeBrokers;
 };
 
 
@@ -0,0 +1,85 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Serial output of bridge-generated lines, subject to flow control.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "reply_buffer.h"
+
+
+ReplyBuffer::ReplyBuffer (Print &output, const bool &paused)
+    : output(output),
+      paused(paused),
+      used(0),
+      lineStart(0),
+      discarding(false),
+      dropped(0)
+{
+}
+
+
+size_t ReplyBuffer::write (uint8_t c)
+{
+    if (discarding) {
+        discarding = (c != '\n');
+        return 1;
+    }
+
+    // Nothing held back; write through
+    if (!paused && !used) {
+        return output.write(c);
+    }
+
+    if (used == sizeof(buffer)) {
+        // Out of space; drop the incomplete line, and the rest of it
+        used = lineStart;
+        dropped++;
+        discarding = (c != '\n');
+        return 1;
+    }
+
+    buffer[used++] = c;
+    if (c == '\n') {
+        lineStart = used;
+    }
+
+    return 1;
+}
+
+size_t ReplyBuffer::write (const uint8_t *data, size_t size)
+{
+    if (!discarding && !paused && !used) {
+        return output.write(data, size);
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        write(data[i]);
+    }
+
+    return size;
+}
+
+void ReplyBuffer::drain ()
+{
+    if (paused || !used) {
+        return;
+    }
+
+    output.write(buffer, used);
+    used = 0;
+    lineStart = 0;
+}
+
+
+uint16_t ReplyBuffer::getUsed () const
+{
+    return used;
+}
+
+uint32_t ReplyBuffer::getDropped () const
+{
+    return dropped;
+}
@@ -0,0 +1,49 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Serial output of bridge-generated lines, subject to flow control.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__REPLY_BUFFER_H
+#define GUIO_ESP8266__REPLY_BUFFER_H
+
+#include "config.h"
+
+#include <Arduino.h>
+
+
+// Command responses (and other lines generated by the bridge) are
+// written through this buffer. While the back-end has paused our
+// output, they are held back, and written once it resumes. Lines that
+// do not fit into the buffer are dropped as a whole.
+class ReplyBuffer : public Print
+{
+public:
+    ReplyBuffer (Print &output, const bool &paused);
+
+    size_t write (uint8_t c) override;
+    size_t write (const uint8_t *data, size_t size) override;
+    using Print::write;
+
+    // Write the held-back output, unless (still) paused
+    void drain ();
+
+    uint16_t getUsed () const;
+    uint32_t getDropped () const;
+
+protected:
+    Print &output;
+    const bool &paused;
+
+    uint8_t buffer[_GUIO_SERIAL_REPLY_BUFFER];
+    uint16_t used;
+    uint16_t lineStart; // start of the incomplete line in the buffer
+    bool discarding; // rest of the current line is dropped
+    uint32_t dropped; // lines
+};
+
+
+#endif
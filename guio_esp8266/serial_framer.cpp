@@ -0,0 +1,54 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Splitting of serial input into lines.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "serial_framer.h"
+
+
+SerialFramer::SerialFramer ()
+    : buffer(),
+      len(0),
+      complete(false),
+      truncated(false),
+      truncatedLines(0)
+{
+}
+
+
+bool SerialFramer::feed (char c)
+{
+    // Start new line after the previous one was consumed
+    if (complete) {
+        len = 0;
+        complete = false;
+        truncated = false;
+    }
+
+    if (c == '\n') {
+        // NULL terminate the buffer
+        buffer[len] = 0;
+        // Check if preceding character was \r; if it was, strip it away
+        if (len > 0 && buffer[len-1] == '\r') {
+            buffer[--len] = 0;
+        }
+        if (truncated) {
+            truncatedLines++;
+        }
+        complete = true;
+        return true;
+    }
+
+    // Read into buffer, truncate on overflow
+    if (len < sizeof(buffer) - 1) {
+        buffer[len++] = c;
+    } else {
+        truncated = true;
+    }
+
+    return false;
+}
@@ -0,0 +1,55 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Splitting of serial input into lines.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__SERIAL_FRAMER_H
+#define GUIO_ESP8266__SERIAL_FRAMER_H
+
+// NOTE: this module does not depend on Arduino, as it is also built
+// by the host harness (libguio_host)
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Lines are terminated by LF, with optional preceding CR (which is
+// stripped). Lines that exceed the buffer are truncated.
+class SerialFramer
+{
+public:
+    SerialFramer ();
+
+    // Returns true once a line is complete; the line remains available
+    // until the next call
+    bool feed (char c);
+
+    // Current line (NULL terminated once complete)
+    char *line ()
+    {
+        return buffer;
+    }
+
+    uint16_t length () const
+    {
+        return len;
+    }
+
+    uint32_t getTruncatedLines () const
+    {
+        return truncatedLines;
+    }
+
+protected:
+    char buffer[256]; // 255 + NULL
+    uint16_t len;
+    bool complete;
+    bool truncated;
+    uint32_t truncatedLines;
+};
+
+
+#endif
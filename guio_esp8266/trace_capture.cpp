@@ -0,0 +1,234 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Capture of serial and MQTT traffic into a binary trace file.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "trace_capture.h"
+
+#include <LittleFS.h>
+
+
+static const char TRACE_FILENAME[] = "/capture.bin";
+static const uint8_t TRACE_HEADER[5] PROGMEM = { 'G', 'T', 'R', 'C', 2 };
+
+// Upper bound of the record's overhead: time (5), type (1) and payload
+// length (5), preceded by a timestamp record (1 + 1 + 1 + 5)
+static const unsigned int TRACE_RECORD_OVERHEAD = 19;
+
+
+static uint8_t encodeVarint (uint32_t value, uint8_t *encoded)
+{
+    uint8_t len = 0;
+
+    do {
+        encoded[len] = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            encoded[len] |= 0x80;
+        }
+        len++;
+    } while (value);
+
+    return len;
+}
+
+
+TraceCapture::TraceCapture ()
+    : active(false),
+      bufferUsed(0),
+      startTimestamp(0),
+      lastTimestamp(0),
+      records(0),
+      size(0),
+      dropped(0)
+{
+}
+
+
+bool TraceCapture::start ()
+{
+    if (active) {
+        return true;
+    }
+
+    // Close the previous capture, if it is still pending
+    stop();
+
+    if (!LittleFS.begin()) {
+        GDBG_println(F("Failed to mount file system for capture!"));
+        return false;
+    }
+
+    // Start a new capture; the previous one is overwritten
+    file = LittleFS.open(TRACE_FILENAME, "w");
+    if (!file) {
+        GDBG_println(F("Failed to open capture file!"));
+        return false;
+    }
+
+    active = true;
+    bufferUsed = 0;
+    records = 0;
+    size = 0;
+    dropped = 0;
+
+    uint8_t header[sizeof(TRACE_HEADER)];
+    memcpy_P(header, TRACE_HEADER, sizeof(header));
+    append(header, sizeof(header));
+
+    startTimestamp = lastTimestamp = micros64();
+
+    return true;
+}
+
+void TraceCapture::stop ()
+{
+    active = false;
+    flush();
+}
+
+bool TraceCapture::isActive () const
+{
+    return active;
+}
+
+uint32_t TraceCapture::getRecords () const
+{
+    return records;
+}
+
+uint32_t TraceCapture::getSize () const
+{
+    return size;
+}
+
+uint32_t TraceCapture::getDropped () const
+{
+    return dropped;
+}
+
+
+// The caller ensures that the data fits into the buffer
+void TraceCapture::append (const uint8_t *data, unsigned int length)
+{
+    memcpy(buffer + bufferUsed, data, length);
+    bufferUsed += length;
+}
+
+void TraceCapture::appendVarint (uint32_t value)
+{
+    uint8_t encoded[5];
+    append(encoded, encodeVarint(value, encoded));
+}
+
+void TraceCapture::flush ()
+{
+    if (!file) {
+        return;
+    }
+
+    if (bufferUsed) {
+        file.write(buffer, bufferUsed);
+        size += bufferUsed;
+        bufferUsed = 0;
+    }
+
+    if (!active) {
+        file.close();
+    }
+}
+
+
+void TraceCapture::record (TraceDirection direction, uint8_t channel, const uint8_t *data, unsigned int length)
+{
+    if (!active) {
+        return;
+    }
+
+    // Stop when the size limit is reached; the file is closed by the
+    // next flush()
+    if (size + bufferUsed + length + TRACE_RECORD_OVERHEAD > _GUIO_CAPTURE_MAX_SIZE) {
+        GDBG_println(F("Capture size limit reached!"));
+        active = false;
+        return;
+    }
+
+    // Drop the record if the buffer has not been flushed in time; the
+    // next record's time includes the dropped one's
+    if (bufferUsed + length + TRACE_RECORD_OVERHEAD > sizeof(buffer)) {
+        dropped++;
+        return;
+    }
+
+    uint64_t now = micros64();
+
+    // The time since the previous record does not fit into 32 bits
+    // (over 71 minutes); emit the absolute time first
+    if (now - lastTimestamp > UINT32_MAX) {
+        uint32_t elapsed = (now - startTimestamp) / 1000;
+        uint8_t encoded[5];
+        uint8_t len = encodeVarint(elapsed, encoded);
+
+        appendVarint(0);
+        uint8_t type = TRACE_TIMESTAMP;
+        append(&type, 1);
+        appendVarint(len);
+        append(encoded, len);
+
+        lastTimestamp = startTimestamp + (uint64_t)elapsed * 1000;
+    }
+
+    appendVarint(now - lastTimestamp);
+    uint8_t type = (channel << 4) | direction;
+    append(&type, 1);
+    appendVarint(length);
+    append(data, length);
+
+    lastTimestamp = now;
+    records++;
+}
+
+
+bool TraceCapture::dump (Print &output)
+{
+    if (active) {
+        return false;
+    }
+
+    // Close the capture, if it is still pending
+    stop();
+
+    if (!LittleFS.begin()) {
+        return false;
+    }
+
+    File input = LittleFS.open(TRACE_FILENAME, "r");
+    if (!input) {
+        return false;
+    }
+
+    // Hex-encoded chunks, so that the dump does not interfere with
+    // line-based protocol: !CAPDATA <hex> ... !CAPEND <size>
+    uint32_t total = 0;
+    uint8_t chunk[64];
+    int len;
+    while ((len = input.read(chunk, sizeof(chunk))) > 0) {
+        output.print(F("!CAPDATA "));
+        for (int i = 0; i < len; i++) {
+            output.printf_P(PSTR("%02x"), chunk[i]);
+        }
+        output.println();
+        total += len;
+        yield();
+    }
+    input.close();
+
+    output.print(F("!CAPEND "));
+    output.println(total);
+
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * GUI-O ESP8266 bridge
+ * Capture of serial and MQTT traffic into a binary trace file.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__TRACE_CAPTURE_H
+#define GUIO_ESP8266__TRACE_CAPTURE_H
+
+#include "config.h"
+
+#include <Arduino.h>
+#include <FS.h>
+
+
+// Trace file format (all multi-byte integers are unsigned LEB128
+// varints):
+//  - header: "GTRC" + format version (1 byte)
+//  - records, each consisting of:
+//     - time since previous record (or start of capture) in microseconds
+//     - type byte: direction in low nibble, channel in high nibble
+//     - payload length
+//     - payload (line without CRLF; serial lines include the prefix)
+// When the time since the previous record does not fit into 32 bits,
+// a timestamp record is emitted first; its payload is the time since
+// the start of capture in milliseconds (varint), and the following
+// record's time is relative to it.
+enum TraceDirection
+{
+    TRACE_SERIAL_IN = 0, // serial line from back-end ($ or !)
+    TRACE_MQTT_IN = 1, // message received from MQTT broker
+    TRACE_MQTT_OUT = 2, // message published to MQTT broker
+    TRACE_TIMESTAMP = 3, // absolute time (internal)
+};
+
+
+class TraceCapture
+{
+public:
+    TraceCapture ();
+
+    bool start ();
+    void stop ();
+    bool isActive () const;
+
+    void record (TraceDirection direction, uint8_t channel, const uint8_t *data, unsigned int length);
+
+    // Write the buffered records to flash; called periodically (from a
+    // task) rather than from record(), so that the serial and MQTT
+    // paths never wait for the flash. Once the capture has stopped,
+    // this also closes the file.
+    void flush ();
+
+    bool dump (Print &output);
+
+    uint32_t getRecords () const;
+    uint32_t getSize () const;
+    uint32_t getDropped () const;
+
+protected:
+    void append (const uint8_t *data, unsigned int length);
+    void appendVarint (uint32_t value);
+
+protected:
+    File file;
+    bool active;
+
+    // Records are buffered in RAM until flushed; records that do not
+    // fit are dropped
+    uint8_t buffer[_GUIO_CAPTURE_BUFFER_SIZE];
+    uint16_t bufferUsed;
+
+    uint64_t startTimestamp;
+    uint64_t lastTimestamp;
+    uint32_t records;
+    uint32_t size;
+    uint32_t dropped;
+};
+
+
+#endif
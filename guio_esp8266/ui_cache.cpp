@@ -0,0 +1,501 @@
+/*
+ * GUI-O ESP8266 bridge
+ * GUI-O UI state mirror cache.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ui_cache.h"
+
+
+// Record layout
+#define RECORD_CHANNEL(rec) ((rec)[0])
+#define RECORD_UID_LEN(rec) ((rec)[1])
+#define RECORD_NAME_LEN(rec) ((rec)[2])
+#define RECORD_VALUE_LEN(rec) ((rec)[3])
+#define RECORD_UID(rec) ((const char *)(rec) + 4)
+#define RECORD_NAME(rec) (RECORD_UID(rec) + RECORD_UID_LEN(rec))
+#define RECORD_VALUE(rec) (RECORD_NAME(rec) + RECORD_NAME_LEN(rec))
+#define RECORD_SIZE(rec) (4 + RECORD_UID_LEN(rec) + RECORD_NAME_LEN(rec) + RECORD_VALUE_LEN(rec))
+
+
+UiCache::UiCache ()
+    : arenaUsed(0)
+{
+    memset(channels, 0, sizeof(channels));
+}
+
+
+void UiCache::setEnabled (uint8_t channel, bool enabled)
+{
+    // Either way, start from scratch; the cache becomes valid with
+    // the next screen (re)initialization
+    invalidate(channel);
+    channels[channel].enabled = enabled;
+}
+
+bool UiCache::isEnabled (uint8_t channel) const
+{
+    return channels[channel].enabled;
+}
+
+void UiCache::invalidate (uint8_t channel)
+{
+    clear(channel);
+    channels[channel].valid = false;
+}
+
+uint16_t UiCache::getUsed () const
+{
+    return arenaUsed;
+}
+
+uint32_t UiCache::getSuppressed (uint8_t channel) const
+{
+    return channels[channel].suppressed;
+}
+
+uint32_t UiCache::getReplayed (uint8_t channel) const
+{
+    return channels[channel].replayed;
+}
+
+
+int UiCache::tokenize (const char *line, token_t *tokens)
+{
+    // Split the line on spaces (except within double quotes); for each
+    // token, split NAME:value pair on the first colon. The first token
+    // is the command itself and is never split.
+    int count = 0;
+
+    while (*line) {
+        if (*line == ' ') {
+            line++;
+            continue;
+        }
+
+        if (count == MAX_TOKENS) {
+            return -1; // too many tokens
+        }
+
+        const char *start = line;
+        const char *colon = nullptr;
+        bool quoted = false;
+        while (*line && (quoted || *line != ' ')) {
+            if (*line == '"') {
+                quoted = !quoted;
+            } else if (*line == ':' && !colon && !quoted && count > 0) {
+                colon = line;
+            }
+            line++;
+        }
+
+        token_t &token = tokens[count++];
+        token.name = start;
+        if (colon) {
+            token.nameLen = colon - start;
+            token.value = colon + 1;
+            token.valueLen = line - colon - 1;
+        } else {
+            token.nameLen = line - start;
+            token.value = nullptr;
+            token.valueLen = 0;
+        }
+    }
+
+    return count;
+}
+
+
+int UiCache::findRecord (uint8_t channel, const char *uid, uint8_t uidLen, const char *name, uint8_t nameLen) const
+{
+    for (uint16_t offset = 0; offset < arenaUsed; offset += RECORD_SIZE(arena + offset)) {
+        const uint8_t *rec = arena + offset;
+        if (RECORD_CHANNEL(rec) == channel &&
+            RECORD_UID_LEN(rec) == uidLen && RECORD_NAME_LEN(rec) == nameLen &&
+            memcmp(RECORD_UID(rec), uid, uidLen) == 0 && memcmp(RECORD_NAME(rec), name, nameLen) == 0) {
+            return offset;
+        }
+    }
+
+    return -1;
+}
+
+bool UiCache::hasRecords (uint8_t channel, const char *uid, uint8_t uidLen) const
+{
+    for (uint16_t offset = 0; offset < arenaUsed; offset += RECORD_SIZE(arena + offset)) {
+        const uint8_t *rec = arena + offset;
+        if (RECORD_CHANNEL(rec) == channel && RECORD_UID_LEN(rec) == uidLen && memcmp(RECORD_UID(rec), uid, uidLen) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool UiCache::appendRecord (uint8_t channel, const char *uid, uint8_t uidLen, const char *name, uint8_t nameLen, const char *value, uint8_t valueLen)
+{
+    uint16_t size = 4 + uidLen + nameLen + valueLen;
+    if (arenaUsed + size > sizeof(arena)) {
+        return false; // out of space
+    }
+
+    uint8_t *rec = arena + arenaUsed;
+    RECORD_CHANNEL(rec) = channel;
+    RECORD_UID_LEN(rec) = uidLen;
+    RECORD_NAME_LEN(rec) = nameLen;
+    RECORD_VALUE_LEN(rec) = valueLen;
+    memcpy(rec + 4, uid, uidLen);
+    memcpy(rec + 4 + uidLen, name, nameLen);
+    memcpy(rec + 4 + uidLen + nameLen, value, valueLen);
+
+    arenaUsed += size;
+
+    return true;
+}
+
+void UiCache::removeRecord (int offset)
+{
+    uint16_t size = RECORD_SIZE(arena + offset);
+    memmove(arena + offset, arena + offset + size, arenaUsed - offset - size);
+    arenaUsed -= size;
+}
+
+void UiCache::removeObject (uint8_t channel, const char *uid, uint8_t uidLen)
+{
+    // Object record and all its property records
+    uint16_t offset = 0;
+    while (offset < arenaUsed) {
+        const uint8_t *rec = arena + offset;
+        if (RECORD_CHANNEL(rec) == channel && RECORD_UID_LEN(rec) == uidLen && memcmp(RECORD_UID(rec), uid, uidLen) == 0) {
+            removeRecord(offset);
+        } else {
+            offset += RECORD_SIZE(rec);
+        }
+    }
+}
+
+void UiCache::clear (uint8_t channel)
+{
+    uint16_t offset = 0;
+    while (offset < arenaUsed) {
+        if (RECORD_CHANNEL(arena + offset) == channel) {
+            removeRecord(offset);
+        } else {
+            offset += RECORD_SIZE(arena + offset);
+        }
+    }
+}
+
+
+bool UiCache::processOutgoing (uint8_t channel, const char *line)
+{
+    channel_state_t &state = channels[channel];
+
+    if (!state.enabled) {
+        return true;
+    }
+
+    // Lines that cannot be cached (too long or too many tokens) may
+    // still change the state of cached objects
+    token_t tokens[MAX_TOKENS];
+    int count = strlen(line) <= MAX_LINE ? tokenize(line, tokens) : -1;
+    if (count < 0) {
+        if (state.valid && (line[0] == '@' || line[0] == '|')) {
+            invalidate(channel);
+        }
+        return true;
+    } else if (count == 0) {
+        return true; // Not something we can cache
+    }
+
+    const token_t &command = tokens[0];
+
+    if (command.name[0] == '@') {
+        // Update (@UID PROP:value ...) or screen command (@cls, @sls, ...)
+        const char *uid = command.name + 1;
+        uint8_t uidLen = command.nameLen - 1;
+
+        if (count == 1 && uidLen == 3 && memcmp_P(uid, PSTR("cls"), 3) == 0) {
+            // Clear screen; cache starts from scratch
+            clear(channel);
+            state.valid = true;
+            return true;
+        }
+
+        if (!state.valid || count < 2) {
+            return true;
+        }
+
+        // All arguments must be properties; otherwise, this is not a
+        // state update (e.g., @hls 500). Acknowledgements (CRE:1) must
+        // always reach the front-end, so they are not cached either.
+        for (int i = 1; i < count; i++) {
+            if (!tokens[i].value || (tokens[i].nameLen == 3 && memcmp_P(tokens[i].name, PSTR("CRE"), 3) == 0)) {
+                return true;
+            }
+        }
+
+        // Check if update is redundant (all properties match cached values)
+        bool redundant = true;
+        for (int i = 1; i < count && redundant; i++) {
+            int offset = findRecord(channel, uid, uidLen, tokens[i].name, tokens[i].nameLen);
+            if (offset < 0) {
+                redundant = false;
+            } else {
+                const uint8_t *rec = arena + offset;
+                redundant = RECORD_VALUE_LEN(rec) == tokens[i].valueLen && memcmp(RECORD_VALUE(rec), tokens[i].value, tokens[i].valueLen) == 0;
+            }
+        }
+
+        if (redundant) {
+            state.suppressed++;
+            return false;
+        }
+
+        // Store new values
+        for (int i = 1; i < count; i++) {
+            int offset = findRecord(channel, uid, uidLen, tokens[i].name, tokens[i].nameLen);
+            if (offset >= 0) {
+                if (RECORD_VALUE_LEN(arena + offset) == tokens[i].valueLen) {
+                    memcpy((char *)RECORD_VALUE(arena + offset), tokens[i].value, tokens[i].valueLen);
+                    continue;
+                }
+                removeRecord(offset);
+            }
+            if (!appendRecord(channel, uid, uidLen, tokens[i].name, tokens[i].nameLen, tokens[i].value, tokens[i].valueLen)) {
+                invalidate(channel); // overflow
+                return true;
+            }
+        }
+    } else if (command.name[0] == '|') {
+        // Create (|XX UID:uid PROP:value ...)
+        if (!state.valid) {
+            return true;
+        }
+
+        const token_t *uidToken = nullptr;
+        for (int i = 1; i < count; i++) {
+            if (tokens[i].nameLen == 3 && memcmp_P(tokens[i].name, PSTR("UID"), 3) == 0 && tokens[i].valueLen) {
+                uidToken = &tokens[i];
+                break;
+            }
+        }
+        if (!uidToken) {
+            return true;
+        }
+
+        // (Re-)created object replaces any previous state
+        removeObject(channel, uidToken->value, uidToken->valueLen);
+
+        bool stored = appendRecord(channel, uidToken->value, uidToken->valueLen, "", 0, command.name + 1, command.nameLen - 1);
+        for (int i = 1; i < count && stored; i++) {
+            if (&tokens[i] == uidToken || !tokens[i].value) {
+                continue;
+            }
+            stored = appendRecord(channel, uidToken->value, uidToken->valueLen, tokens[i].name, tokens[i].nameLen, tokens[i].value, tokens[i].valueLen);
+        }
+        if (!stored) {
+            invalidate(channel); // overflow
+        }
+    }
+
+    return true;
+}
+
+
+void UiCache::processIncoming (uint8_t channel, const uint8_t *line, unsigned int length)
+{
+    channel_state_t &state = channels[channel];
+
+    if (!state.enabled || !state.valid) {
+        return;
+    }
+
+    // Widget event (@uid value), optionally requesting acknowledgement
+    // (?@uid value)
+    const char *event = (const char *)line;
+    const char *end = event + length;
+    if (event < end && *event == '?') {
+        event++;
+    }
+    if (event == end || *event != '@') {
+        return;
+    }
+
+    const char *uid = event + 1;
+    const char *value = uid;
+    while (value < end && *value != ' ') {
+        value++;
+    }
+    unsigned int uidLen = value - uid;
+    if (!uidLen || uidLen > MAX_LINE || !hasRecords(channel, uid, uidLen)) {
+        return; // Not a cached widget
+    }
+
+    while (value < end && *value == ' ') {
+        value++;
+    }
+    unsigned int valueLen = end - value;
+    while (valueLen && value[valueLen - 1] == ' ') {
+        valueLen--;
+    }
+    bool quoted = false;
+    for (unsigned int i = 0; i < valueLen; i++) {
+        if (value[i] == '"') {
+            quoted = !quoted;
+        } else if (value[i] == ' ' && !quoted) {
+            valueLen = 0; // more than a single value
+            break;
+        }
+    }
+
+    // The event carries the new value of the widget (e.g., the toggle
+    // state or the slider position), which is cached as VAL property;
+    // the value must fit into a replayed line as @uid VAL:value
+    int offset = findRecord(channel, uid, uidLen, "VAL", 3);
+    if (offset >= 0 && valueLen && 1 + uidLen + 5 + valueLen <= MAX_LINE) {
+        if (RECORD_VALUE_LEN(arena + offset) == valueLen) {
+            memcpy((char *)RECORD_VALUE(arena + offset), value, valueLen);
+            return;
+        }
+        removeRecord(offset);
+        if (appendRecord(channel, uid, uidLen, "VAL", 3, value, valueLen)) {
+            return;
+        }
+    }
+
+    // Otherwise, the state of the widget on the front-end is unknown
+    invalidate(channel);
+}
+
+
+bool UiCache::canReplay (uint8_t channel, const uint8_t *initLine, unsigned int length) const
+{
+    const channel_state_t &state = channels[channel];
+
+    if (!state.enabled || !state.valid || !state.initLine[0]) {
+        return false;
+    }
+
+    // Cached screen was built for the front-end with the same
+    // @init parameters (screen size, etc.)
+    if (strlen(state.initLine) != length || memcmp(state.initLine, initLine, length) != 0) {
+        return false;
+    }
+
+    for (uint16_t offset = 0; offset < arenaUsed; offset += RECORD_SIZE(arena + offset)) {
+        if (RECORD_CHANNEL(arena + offset) == channel) {
+            return true;
+        }
+    }
+
+    return false; // Nothing to replay
+}
+
+void UiCache::storeInit (uint8_t channel, const uint8_t *initLine, unsigned int length)
+{
+    channel_state_t &state = channels[channel];
+
+    // The back-end will rebuild the screen from scratch
+    clear(channel);
+    state.valid = true;
+
+    if (length < sizeof(state.initLine)) {
+        memcpy(state.initLine, initLine, length);
+        state.initLine[length] = 0;
+    } else {
+        state.initLine[0] = 0; // too long; never replay
+    }
+}
+
+bool UiCache::emitObject (int offset, bool create, EmitFunction &emit) const
+{
+    const uint8_t *object = arena + offset;
+    uint8_t channel = RECORD_CHANNEL(object);
+    const char *uid = RECORD_UID(object);
+    uint8_t uidLen = RECORD_UID_LEN(object);
+
+    char line[256];
+    int len;
+
+    if (create) {
+        len = snprintf_P(line, sizeof(line), PSTR("|%.*s UID:%.*s"), RECORD_VALUE_LEN(object), RECORD_VALUE(object), uidLen, uid);
+    } else {
+        len = snprintf_P(line, sizeof(line), PSTR("@%.*s"), uidLen, uid);
+    }
+
+    // Append all properties; if they do not fit into a single line,
+    // continue with update command(s)
+    for (uint16_t pos = 0; pos < arenaUsed; pos += RECORD_SIZE(arena + pos)) {
+        const uint8_t *rec = arena + pos;
+        if (RECORD_CHANNEL(rec) != channel || !RECORD_NAME_LEN(rec) ||
+            RECORD_UID_LEN(rec) != uidLen || memcmp(RECORD_UID(rec), uid, uidLen) != 0) {
+            continue;
+        }
+
+        unsigned int propLen = 1 + RECORD_NAME_LEN(rec) + 1 + RECORD_VALUE_LEN(rec);
+        if (len + propLen >= sizeof(line)) {
+            emit(line);
+            len = snprintf_P(line, sizeof(line), PSTR("@%.*s"), uidLen, uid);
+            if (len + propLen >= sizeof(line)) {
+                return false; // cannot happen with lines up to MAX_LINE characters
+            }
+        }
+
+        len += snprintf_P(line + len, sizeof(line) - len, PSTR(" %.*s:%.*s"), RECORD_NAME_LEN(rec), RECORD_NAME(rec), RECORD_VALUE_LEN(rec), RECORD_VALUE(rec));
+    }
+
+    emit(line);
+
+    return true;
+}
+
+bool UiCache::replay (uint8_t channel, EmitFunction emit)
+{
+    channel_state_t &state = channels[channel];
+
+    if (!state.enabled || !state.valid) {
+        return false;
+    }
+
+    // First, update-only targets (e.g., @guis) - these have property
+    // records, but no object record. Emit each only once, at its
+    // first property record.
+    for (uint16_t offset = 0; offset < arenaUsed; offset += RECORD_SIZE(arena + offset)) {
+        const uint8_t *rec = arena + offset;
+        if (RECORD_CHANNEL(rec) != channel || !RECORD_NAME_LEN(rec)) {
+            continue;
+        }
+
+        const char *uid = RECORD_UID(rec);
+        uint8_t uidLen = RECORD_UID_LEN(rec);
+        if (findRecord(channel, uid, uidLen, "", 0) >= 0) {
+            continue; // has object record
+        }
+
+        bool first = true;
+        for (uint16_t pos = 0; pos < offset && first; pos += RECORD_SIZE(arena + pos)) {
+            const uint8_t *other = arena + pos;
+            first = !(RECORD_CHANNEL(other) == channel && RECORD_UID_LEN(other) == uidLen && memcmp(RECORD_UID(other), uid, uidLen) == 0);
+        }
+
+        if (first) {
+            emitObject(offset, false, emit);
+        }
+    }
+
+    // Then objects, in order of creation, with their latest properties
+    for (uint16_t offset = 0; offset < arenaUsed; offset += RECORD_SIZE(arena + offset)) {
+        const uint8_t *rec = arena + offset;
+        if (RECORD_CHANNEL(rec) == channel && !RECORD_NAME_LEN(rec)) {
+            emitObject(offset, true, emit);
+        }
+    }
+
+    state.replayed++;
+
+    return true;
+}
@@ -0,0 +1,103 @@
+/*
+ * GUI-O ESP8266 bridge
+ * GUI-O UI state mirror cache.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_ESP8266__UI_CACHE_H
+#define GUIO_ESP8266__UI_CACHE_H
+
+// NOTE: this module does not depend on Arduino, as it is also built
+// by the host unit tests (libguio_host)
+#include "config.h"
+#include "pgmspace_compat.h"
+
+#include <stdint.h>
+
+#include <functional>
+
+
+class UiCache
+{
+public:
+    typedef std::function<void (const char *line)> EmitFunction;
+
+    UiCache ();
+
+    void setEnabled (uint8_t channel, bool enabled);
+    bool isEnabled (uint8_t channel) const;
+
+    // Drop the cached state of the channel; caching resumes with the
+    // next screen (re)initialization
+    void invalidate (uint8_t channel);
+
+    // Back-end -> front-end; returns false if the line is redundant
+    // and should not be published
+    bool processOutgoing (uint8_t channel, const char *line);
+
+    // Front-end -> back-end widget event (@uid value); the cached
+    // value of the widget is updated or, if unknown, the channel's
+    // state is dropped
+    void processIncoming (uint8_t channel, const uint8_t *line, unsigned int length);
+
+    // Front-end -> back-end @init
+    bool canReplay (uint8_t channel, const uint8_t *initLine, unsigned int length) const;
+    void storeInit (uint8_t channel, const uint8_t *initLine, unsigned int length);
+    bool replay (uint8_t channel, EmitFunction emit);
+
+    uint16_t getUsed () const;
+    uint32_t getSuppressed (uint8_t channel) const;
+    uint32_t getReplayed (uint8_t channel) const;
+
+protected:
+    struct token_t
+    {
+        const char *name;
+        uint8_t nameLen;
+        const char *value;
+        uint8_t valueLen;
+    };
+
+    static const uint8_t MAX_TOKENS = 16;
+
+    // Longest line that is cached; record lengths are 8-bit, and any
+    // cached property must fit into a replayed line
+    static const uint16_t MAX_LINE = 255;
+
+    static int tokenize (const char *line, token_t *tokens);
+
+    int findRecord (uint8_t channel, const char *uid, uint8_t uidLen, const char *name, uint8_t nameLen) const;
+    bool hasRecords (uint8_t channel, const char *uid, uint8_t uidLen) const;
+    bool appendRecord (uint8_t channel, const char *uid, uint8_t uidLen, const char *name, uint8_t nameLen, const char *value, uint8_t valueLen);
+    void removeRecord (int offset);
+    void removeObject (uint8_t channel, const char *uid, uint8_t uidLen);
+    void clear (uint8_t channel);
+
+    bool emitObject (int offset, bool create, EmitFunction &emit) const;
+
+protected:
+    // Records are packed in the arena one after another; each consists
+    // of 4-byte header (channel, uid length, name length, value length)
+    // followed by uid, name and value strings (not NULL-terminated).
+    // Object (create) records have empty name and the widget type as
+    // value; property records hold the last value of the property.
+    uint8_t arena[_GUIO_UI_CACHE_SIZE];
+    uint16_t arenaUsed;
+
+    struct channel_state_t
+    {
+        bool enabled;
+        bool valid; // cleared on overflow or lost message
+        char initLine[48];
+        uint32_t suppressed;
+        uint32_t replayed;
+    };
+
+    channel_state_t channels[_GUIO_CHANNELS];
+};
+
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * GUI-O host library
+ * Throughput benchmark against the bridge (or any line echo endpoint).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/bridge.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+
+using namespace guio;
+using Clock = std::chrono::steady_clock;
+
+
+struct bench_options_t
+{
+    std::string port = "/dev/ttyUSB0";
+    unsigned baudrate = 115200;
+    std::string flowControl = "none";
+    std::string mode = "ping";
+    uint32_t count = 1000;
+    uint32_t window = 1; // ping: outstanding pings
+    uint32_t size = 64; // stream: message size (bytes)
+    uint32_t batch = 32; // stream: messages per write
+    bool echo = false; // stream: wait for messages to be echoed back
+    bool compress = false; // stream: negotiate payload compression
+};
+
+
+static double elapsedSeconds (Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void printTransportStats (const Transport &transport, uint64_t lines)
+{
+    const transport_stats_t &stats = transport.getStats();
+    printf("write syscalls: %llu (%.1f lines/syscall), read syscalls: %llu\n",
+        (unsigned long long)stats.writeCalls,
+        stats.writeCalls ? (double)lines / stats.writeCalls : 0.0,
+        (unsigned long long)stats.readCalls);
+}
+
+
+// Command round-trip: !PING -> !PONG, with a window of outstanding pings
+static int runPing (EventLoop &loop, Bridge &bridge, const bench_options_t &options)
+{
+    std::vector<uint32_t> rtts;
+    rtts.reserve(options.count);
+
+    uint32_t sent = 0;
+    Clock::time_point start = Clock::now();
+
+    bridge.setPongCallback([&] (StatusCode, std::chrono::microseconds rtt) {
+        rtts.push_back(rtt.count());
+        if (sent < options.count) {
+            bridge.ping();
+            sent++;
+        } else if (rtts.size() == options.count) {
+            loop.stop();
+        }
+    });
+
+    for (; sent < std::min(options.window, options.count); sent++) {
+        bridge.ping();
+    }
+
+    loop.run();
+
+    double elapsed = elapsedSeconds(start);
+
+    if (rtts.empty()) {
+        fprintf(stderr, "ERROR: no responses!\n");
+        return 1;
+    }
+
+    std::sort(rtts.begin(), rtts.end());
+    uint64_t sum = 0;
+    for (uint32_t rtt : rtts) {
+        sum += rtt;
+    }
+
+    printf("pings: %zu in %.3f s (%.1f commands/s)\n", rtts.size(), elapsed, rtts.size() / elapsed);
+    printf("rtt (us): mean %llu, p50 %u, p99 %u, max %u\n",
+        (unsigned long long)(sum / rtts.size()),
+        rtts[rtts.size() / 2],
+        rtts[std::min(rtts.size() - 1, rtts.size() * 99 / 100)],
+        rtts.back());
+    printf("status: %s\n", statusName(bridge.getStatus()));
+    printTransportStats(bridge.getTransport(), bridge.getStats().linesSent);
+
+    return 0;
+}
+
+
+// Pass-through stream: $-prefixed messages, as fast as the transport
+// (and back-pressure) allows
+static int runStream (EventLoop &loop, Bridge &bridge, const bench_options_t &options)
+{
+    // @lbBench TXT:"<index> xxx..."
+    std::string filler(options.size > 32 ? options.size - 32 : 1, 'x');
+
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint32_t congestions = 0;
+    uint64_t bytes = 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point sendEnd;
+
+    std::function<void ()> produce = [&] () {
+        CommandBuilder &commands = bridge.commands();
+        for (uint32_t i = 0; i < options.batch && sent < options.count; i++, sent++) {
+            size_t before = commands.size();
+            commands.guiof("@lbBench TXT:\"%u %s\"", sent, filler.c_str());
+            bytes += commands.size() - before;
+        }
+        bridge.flush();
+
+        if (sent < options.count) {
+            if (bridge.congested()) {
+                // Resumed by the writable callback
+                congestions++;
+            } else {
+                loop.defer(produce);
+            }
+        } else {
+            sendEnd = Clock::now();
+            if (!options.echo) {
+                // Wait for the output queue to drain
+                loop.addTimer(10, [&] () {
+                    if (!bridge.getTransport().pending()) {
+                        sendEnd = Clock::now();
+                        loop.stop();
+                    }
+                });
+            }
+        }
+    };
+
+    bridge.getTransport().setWatermarks(16 * 1024, 64 * 1024);
+    bridge.setWritableCallback([&] () {
+        if (sent < options.count) {
+            produce();
+        }
+    });
+    bridge.setGuioCallback([&] (int, std::string_view message) {
+        if (message.compare(0, 9, "@lbBench ") == 0 && ++received == options.count) {
+            loop.stop();
+        }
+    });
+
+    if (options.compress) {
+        // Start once the compression is negotiated (or after a timeout)
+        bridge.setCompression(true);
+        int attempts = 0;
+        int timer = -1;
+        timer = loop.addTimer(10, [&] () {
+            if (bridge.isCompressionActive() || ++attempts == 100) {
+                if (!bridge.isCompressionActive()) {
+                    fprintf(stderr, "WARNING: compression not supported by the bridge!\n");
+                }
+                loop.removeTimer(timer);
+                start = Clock::now();
+                produce();
+            }
+        });
+    } else {
+        produce();
+    }
+    loop.run();
+
+    double elapsed = elapsedSeconds(start);
+    double sendElapsed = std::chrono::duration<double>(sendEnd - start).count();
+
+    printf("sent: %u messages, %llu bytes in %.3f s (%.1f messages/s, %.1f kB/s)\n",
+        sent, (unsigned long long)bytes, sendElapsed, sent / sendElapsed, bytes / sendElapsed / 1000);
+    if (options.echo) {
+        printf("echoed: %u messages in %.3f s (%.1f messages/s)\n", received, elapsed, received / elapsed);
+    }
+    if (options.compress) {
+        const bridge_stats_t &stats = bridge.getStats();
+        printf("compression: %llu -> %llu bytes (%.1f%%)\n",
+            (unsigned long long)stats.plainBytes, (unsigned long long)stats.codedBytes,
+            stats.plainBytes ? 100.0 * stats.codedBytes / stats.plainBytes : 100.0);
+    }
+    printf("back-pressure: %u times\n", congestions);
+    printTransportStats(bridge.getTransport(), bridge.getStats().linesSent);
+
+    return 0;
+}
+
+
+static void usage (const char *program)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "GUI-O bridge throughput benchmark.\n"
+        "\n"
+        "Options:\n"
+        "  --port <endpoint>     serial port or tcp:host:port (default: /dev/ttyUSB0)\n"
+        "  --baudrate <rate>     communication baudrate (default: 115200)\n"
+        "  --flow-control <mode> none, rtscts or xonxoff (default: none)\n"
+        "  --mode <mode>         ping or stream (default: ping)\n"
+        "  --count <n>           number of commands/messages (default: 1000)\n"
+        "  --window <n>          ping: outstanding pings (default: 1)\n"
+        "  --size <bytes>        stream: message size (default: 64)\n"
+        "  --batch <n>           stream: messages per write (default: 32)\n"
+        "  --echo                stream: wait for messages to be echoed back\n"
+        "  --compress            stream: negotiate payload compression\n",
+        program);
+}
+
+int main (int argc, char **argv)
+{
+    bench_options_t options;
+
+    static const option longOptions[] = {
+        { "port", required_argument, nullptr, 'p' },
+        { "baudrate", required_argument, nullptr, 'b' },
+        { "flow-control", required_argument, nullptr, 'f' },
+        { "mode", required_argument, nullptr, 'm' },
+        { "count", required_argument, nullptr, 'n' },
+        { "window", required_argument, nullptr, 'w' },
+        { "size", required_argument, nullptr, 's' },
+        { "batch", required_argument, nullptr, 'B' },
+        { "echo", no_argument, nullptr, 'e' },
+        { "compress", no_argument, nullptr, 'z' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:b:f:m:n:w:s:B:ezh", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'p': options.port = optarg; break;
+            case 'b': options.baudrate = atoi(optarg); break;
+            case 'f': options.flowControl = optarg; break;
+            case 'm': options.mode = optarg; break;
+            case 'n': options.count = atoi(optarg); break;
+            case 'w': options.window = std::max(1, atoi(optarg)); break;
+            case 's': options.size = atoi(optarg); break;
+            case 'B': options.batch = std::max(1, atoi(optarg)); break;
+            case 'e': options.echo = true; break;
+            case 'z': options.compress = true; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!options.count || (options.mode != "ping" && options.mode != "stream")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        EventLoop loop;
+
+        Bridge bridge(loop, Transport::open(loop, options.port, options.baudrate, options.flowControl == "rtscts"));
+        bridge.setSoftwareFlowControl(options.flowControl == "xonxoff");
+        bridge.setClosedCallback([&loop] () {
+            fprintf(stderr, "ERROR: connection closed!\n");
+            loop.stop();
+        });
+
+        if (options.mode == "ping") {
+            return runPing(loop, bridge, options);
+        } else {
+            return runStream(loop, bridge, options);
+        }
+    } catch (const std::exception &e) {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,336 @@
+/*
+ * GUI-O host library
+ * Micro-benchmarks of the bridge's serial framer, command parser and
+ * pairing handler, with regression gates against in-binary baselines.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "command_parser.h"
+#include "serial_framer.h"
+#ifdef GUIO_HAVE_ARDUINOJSON
+#include "pairing.h"
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Back-end side of a Toggle Counter session (initialization and a few
+// updates), as seen by the bridge
+static const char SESSION[] =
+    "!PING\r\n"
+    "$@sls\r\n"
+    "$@cls\r\n"
+    "$@clh\r\n"
+    "$@guis SCA:1 BGC:#FFFFFF\r\n"
+    "$|LB UID:lbTime1 X:50 Y:5 FSZ:20 TXT:\"Current time (backend):\"\r\n"
+    "$|LB UID:lbTime2 X:50 Y:10 FSZ:20 TXT:\"\"\r\n"
+    "$|TG UID:tg1 X:50 Y:30 RTO:1000\r\n"
+    "$|LB UID:lbCount1 X:50 Y:40 FSZ:20 TXT:\"Toggles (session): 0\"\r\n"
+    "$|LB UID:lbCount2 X:50 Y:45 FSZ:20 TXT:\"Toggles (total): 0\"\r\n"
+    "$|BT UID:btExit X:50 Y:65 W:972 H:222 RTO:1000\r\n"
+    "$|LB UID:lbExit X:50 Y:65 FSZ:20 TXT:Exit\r\n"
+    "$@lbTime2 TXT:\"2020-11-02 14:21:05\"\r\n"
+    "$@hls 500\r\n"
+    "$@tg1 CRE:1\r\n"
+    "$@lbCount1 TXT:\"Toggles (session): 1\"\r\n"
+    "$@lbCount2 TXT:\"Toggles (total): 1\"\r\n"
+    "$@lbTime2 TXT:\"2020-11-02 14:21:06\"\r\n"
+    "!CHSTATS\r\n";
+
+// Regression gates: CPU time of each benchmark relative to its baseline,
+// which is measured in the same binary, so that the gates do not depend
+// on the host's speed
+struct gate_t
+{
+    const char *name;
+    const char *baseline;
+    double maxRatio;
+};
+
+static const gate_t GATES[] = {
+    // Framing must stay within a small factor of a bare copy of the
+    // bytes into the line buffer
+    { "BM_SerialFramer", "BM_LineCopy", 6.0 },
+    // Table-driven dispatch must not be slower than the strcmp() chain
+    // it replaced (with margin for noise at a few ns); pass-through
+    // lines must be rejected without looking at the command names
+    { "BM_CommandParse/PassThrough", "BM_CommandChain/PassThrough", 0.5 },
+    { "BM_CommandParse/FirstCommand", "BM_CommandChain/FirstCommand", 1.5 },
+    { "BM_CommandParse/LastCommand", "BM_CommandChain/LastCommand", 1.0 },
+    { "BM_CommandParse/Unknown", "BM_CommandChain/Unknown", 1.0 },
+    // Validation of the pairing request must not dominate JSON parsing
+    { "BM_PairingRequest", "BM_PairingDeserialize", 2.0 },
+};
+
+
+// The if-else chain of strcmp()/strncmp() calls that preceded the
+// command table; kept as the reference for the table-driven dispatch
+static int parseCommandChain (char *line, char **args)
+{
+    static const char *const exactCommands[] = {
+        "!PING", "!REBOOT", "!REBOOT_AP", "!CLEAR_PARAMS", "!FLOW",
+    };
+    for (const char *command : exactCommands) {
+        if (strcmp(line, command) == 0) {
+            *args = line + strlen(line);
+            return 1;
+        }
+    }
+    if (strncmp(line, "!POWER", 6) == 0 && (line[6] == ' ' || !line[6])) {
+        *args = line + 6;
+        return 1;
+    } else if (strncmp(line, "!MQTT ", 6) == 0) {
+        *args = line + 6;
+        return 1;
+    } else if (strncmp(line, "!CAPTURE", 8) == 0 && (line[8] == ' ' || !line[8])) {
+        *args = line + 8;
+        return 1;
+    } else if (strncmp(line, "!BROKER ", 8) == 0) {
+        *args = line + 8;
+        return 1;
+    } else if (strncmp(line, "!CHANNEL ", 9) == 0) {
+        *args = line + 9;
+        return 1;
+    } else if (strcmp(line, "!CHSTATS") == 0 || strcmp(line, "!MQTTSTATS") == 0) {
+        *args = line + strlen(line);
+        return 1;
+    } else if (strncmp(line, "!TRACE", 6) == 0 && (line[6] == ' ' || !line[6])) {
+        *args = line + 6;
+        return 1;
+    } else if (strcmp(line, "!BROKERS") == 0) {
+        *args = line + 8;
+        return 1;
+    } else if (strncmp(line, "!CACHE ", 7) == 0) {
+        *args = line + 7;
+        return 1;
+    } else if (strncmp(line, "!COMPRESS", 9) == 0 && (line[9] == ' ' || !line[9])) {
+        *args = line + 9;
+        return 1;
+    }
+    return -1;
+}
+
+
+static void BM_SerialFramer (benchmark::State &state)
+{
+    SerialFramer framer;
+    size_t lines = 0;
+
+    for (auto _ : state) {
+        for (const char *c = SESSION; *c; c++) {
+            if (framer.feed(*c)) {
+                lines++;
+            }
+        }
+        benchmark::DoNotOptimize(framer.line());
+    }
+
+    state.SetBytesProcessed(state.iterations() * (sizeof(SESSION) - 1));
+    state.counters["lines"] = benchmark::Counter(lines, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SerialFramer);
+
+// Baseline for the framer: copy of the bytes into a line buffer, split
+// at newlines, without any checks
+static void BM_LineCopy (benchmark::State &state)
+{
+    char line[256];
+    size_t length = 0;
+    size_t lines = 0;
+
+    for (auto _ : state) {
+        for (const char *c = SESSION; *c; c++) {
+            if (*c == '\n') {
+                line[length] = 0;
+                length = 0;
+                lines++;
+            } else {
+                line[length++] = *c;
+            }
+        }
+        benchmark::DoNotOptimize(line);
+    }
+
+    state.SetBytesProcessed(state.iterations() * (sizeof(SESSION) - 1));
+    state.counters["lines"] = benchmark::Counter(lines, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LineCopy);
+
+
+template <typename Parser>
+static void runParser (benchmark::State &state, Parser parser, const char *input)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "%s", input);
+
+    for (auto _ : state) {
+        char *args = nullptr;
+        benchmark::DoNotOptimize(parser(line, &args));
+        benchmark::DoNotOptimize(args);
+    }
+}
+
+static void BM_CommandParse (benchmark::State &state, const char *input)
+{
+    runParser(state, command_parse, input);
+}
+BENCHMARK_CAPTURE(BM_CommandParse, PassThrough, "$@lbTime2 TXT:\"2020-11-02 14:21:05\"");
+BENCHMARK_CAPTURE(BM_CommandParse, FirstCommand, "!PING");
+BENCHMARK_CAPTURE(BM_CommandParse, LastCommand, "!COMPRESS STATS");
+BENCHMARK_CAPTURE(BM_CommandParse, Unknown, "!UNKNOWN_COMMAND");
+
+static void BM_CommandChain (benchmark::State &state, const char *input)
+{
+    runParser(state, parseCommandChain, input);
+}
+BENCHMARK_CAPTURE(BM_CommandChain, PassThrough, "$@lbTime2 TXT:\"2020-11-02 14:21:05\"");
+BENCHMARK_CAPTURE(BM_CommandChain, FirstCommand, "!PING");
+BENCHMARK_CAPTURE(BM_CommandChain, LastCommand, "!COMPRESS STATS");
+BENCHMARK_CAPTURE(BM_CommandChain, Unknown, "!UNKNOWN_COMMAND");
+
+
+// Argument parsers of the configuration commands; the parsers tokenize
+// the arguments in place, so they are restored on each iteration
+template <typename Args, typename Parser>
+static void runArgsParser (benchmark::State &state, Parser parser, const char *input)
+{
+    char args[256];
+    size_t length = strlen(input) + 1;
+
+    for (auto _ : state) {
+        memcpy(args, input, length);
+        Args result;
+        benchmark::DoNotOptimize(parser(args, &result));
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+static void BM_MqttArgs (benchmark::State &state, const char *input)
+{
+    runArgsParser<command_mqtt_args_t>(state, command_parse_mqtt_args, input);
+}
+BENCHMARK_CAPTURE(BM_MqttArgs, Plain, "1883 PLAIN");
+BENCHMARK_CAPTURE(BM_MqttArgs, Fingerprint, "8883 TLS 4E:7F:F3:5A:1C:2B:90:D4:16:A8:3E:55:0C:B1:77:E2:9F:48:6D:03");
+
+static void BM_BrokerArgs (benchmark::State &state, const char *input)
+{
+    runArgsParser<command_broker_args_t>(state, command_parse_broker_args, input);
+}
+BENCHMARK_CAPTURE(BM_BrokerArgs, HostPort, "1 backup1.example.com:8883");
+BENCHMARK_CAPTURE(BM_BrokerArgs, Clear, "2");
+
+static void BM_ChannelArgs (benchmark::State &state, const char *input)
+{
+    runArgsParser<command_channel_args_t>(state, command_parse_channel_args, input);
+}
+BENCHMARK_CAPTURE(BM_ChannelArgs, Topics, "2 guio/app/abc123/ch2 guio/dev/abc123/ch2");
+
+static void BM_CompressArgs (benchmark::State &state, const char *input)
+{
+    runArgsParser<command_compress_args_t>(state, command_parse_compress_args, input);
+}
+BENCHMARK_CAPTURE(BM_CompressArgs, Version, " BOTH 1");
+BENCHMARK_CAPTURE(BM_CompressArgs, Stats, " STATS");
+
+
+#ifdef GUIO_HAVE_ARDUINOJSON
+static const char PAIRING_REQUEST[] =
+    "{\"networkSsid\":\"HomeNetwork\",\"networkPassword\":\"secret123\","
+    "\"mqttHostName\":\"mqtt.gui-o.com\",\"mqttUserName\":\"guio_user\","
+    "\"mqttUserPassword\":\"guio_pass\",\"subscribeTopic\":\"guio/app/abc123\","
+    "\"publishTopic\":\"guio/dev/abc123\",\"mqttPort\":8883,\"mqttTls\":true,"
+    "\"mqttBrokers\":[\"backup1.example.com:8883\",\"10.0.0.5\"]}";
+
+static void BM_PairingRequest (benchmark::State &state)
+{
+    for (auto _ : state) {
+        DynamicJsonDocument document(1024);
+        deserializeJson(document, PAIRING_REQUEST);
+
+        parameters_t params;
+        parameters_init(&params);
+        char errorMessage[256];
+        JsonVariant json = document.as<JsonVariant>();
+        benchmark::DoNotOptimize(pairing_parse_request(json, &params, errorMessage, sizeof(errorMessage)));
+    }
+}
+BENCHMARK(BM_PairingRequest);
+
+// Baseline for the pairing handler: parsing of the request alone
+static void BM_PairingDeserialize (benchmark::State &state)
+{
+    for (auto _ : state) {
+        DynamicJsonDocument document(1024);
+        benchmark::DoNotOptimize(deserializeJson(document, PAIRING_REQUEST));
+    }
+}
+BENCHMARK(BM_PairingDeserialize);
+#endif
+
+
+// Console output; CPU times are collected for the gates (the fastest
+// repetition, or the median if only aggregates are reported)
+class GateReporter : public benchmark::ConsoleReporter
+{
+public:
+    std::map<std::string, double> times; // ns
+
+    void ReportRuns (const std::vector<Run> &runs) override
+    {
+        ConsoleReporter::ReportRuns(runs);
+
+        for (const Run &run : runs) {
+            std::string name = run.run_name.str();
+            if (run.run_type == Run::RT_Aggregate && run.aggregate_name != "median") {
+                continue;
+            }
+            double time = run.GetAdjustedCPUTime() * benchmark::GetTimeUnitMultiplier(benchmark::kNanosecond) / benchmark::GetTimeUnitMultiplier(run.time_unit);
+            auto it = times.find(name);
+            if (it == times.end() || time < it->second) {
+                times[name] = time;
+            }
+        }
+    }
+
+    bool checkGates () const
+    {
+        bool passed = true;
+        for (const gate_t &gate : GATES) {
+            auto time = times.find(gate.name);
+            auto baseline = times.find(gate.baseline);
+            if (time == times.end() || baseline == times.end()) {
+                continue; // not run (filtered out, or not built)
+            }
+
+            double ratio = time->second / baseline->second;
+            bool ok = ratio <= gate.maxRatio;
+            fprintf(ok ? stdout : stderr, "%s: %s %.1f ns / %s %.1f ns = %.2f (max: %.2f)\n", ok ? "OK" : "REGRESSION",
+                gate.name, time->second, gate.baseline, baseline->second, ratio, gate.maxRatio);
+            passed = passed && ok;
+        }
+        return passed;
+    }
+};
+
+int main (int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    GateReporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    return reporter.checkGates() ? 0 : 1;
+}
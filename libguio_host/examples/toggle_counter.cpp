@@ -0,0 +1,293 @@
+/*
+ * GUI-O host library
+ * Toggle Counter demo application (port of toggle_counter.py).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/bridge.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+
+using namespace guio;
+
+
+static bool verbose = false;
+
+#define LOG_INFO(...) do { fprintf(stderr, "INFO: " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOG_DEBUG(...) do { if (verbose) { fprintf(stderr, "DEBUG: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+#define LOG_WARNING(...) do { fprintf(stderr, "WARNING: " __VA_ARGS__); fputc('\n', stderr); } while (0)
+
+
+static uint32_t globalCount = 0; // toggles since start of the program
+
+
+class Application
+{
+public:
+    Application (EventLoop &loop, Bridge &bridge, std::string_view initLine);
+    ~Application ();
+
+    void handleLine (std::string_view line);
+
+    bool active;
+
+protected:
+    void taskUpdateTimeFcn ();
+    void shutdown ();
+
+protected:
+    EventLoop &loop;
+    Bridge &bridge;
+
+    uint32_t count; // toggles in this session
+    int screenW;
+    int screenH;
+
+    int timerUpdateTime;
+};
+
+
+Application::Application (EventLoop &loop, Bridge &bridge, std::string_view initLine)
+    : active(true),
+      loop(loop),
+      bridge(bridge),
+      count(0),
+      screenW(0),
+      screenH(0),
+      timerUpdateTime(-1)
+{
+    CommandBuilder &commands = bridge.commands();
+
+    // Show loading animation
+    commands.guio("@sls");
+
+    // Parse the init line: @init DPW:<width> DPH:<height> ...
+    std::string init(initLine);
+    sscanf(init.c_str(), "@init DPW:%d DPH:%d", &screenW, &screenH);
+
+    LOG_INFO("Initializing application...");
+    LOG_INFO("Target screen size: %dx%d", screenW, screenH);
+
+    // Clear everything
+    commands.guio("@cls");
+    commands.guio("@clh");
+
+    // UI scaling, background color
+    commands.guio("@guis SCA:1 BGC:#FFFFFF");
+
+    const int fontSize = 20;
+
+    // Create labels for current time
+    commands.guiof("|LB UID:lbTime1 X:50 Y:5 FSZ:%d TXT:\"Current time (backend):\"", fontSize);
+    commands.guiof("|LB UID:lbTime2 X:50 Y:10 FSZ:%d TXT:\"\"", fontSize);
+
+    // Create a toggle with acknowledge-request time of 1 second
+    commands.guio("|TG UID:tg1 X:50 Y:30 RTO:1000");
+
+    // Create labels for toggle count
+    commands.guiof("|LB UID:lbCount1 X:50 Y:40 FSZ:%d TXT:\"Toggles (session): %u\"", fontSize, count);
+    commands.guiof("|LB UID:lbCount2 X:50 Y:45 FSZ:%d TXT:\"Toggles (total): %u\"", fontSize, globalCount);
+
+    // Button with a label
+    int btnW = (int)floor(screenW * 0.90);
+    int btnH = (int)floor(screenH * 0.10);
+    commands.guiof("|BT UID:btExit X:50 Y:65 W:%d H:%d RTO:1000", btnW, btnH);
+    commands.guiof("|LB UID:lbExit X:50 Y:65 FSZ:%d TXT:Exit", fontSize);
+
+    // Time update task; once per second
+    timerUpdateTime = loop.addTimer(1000, [this] () {
+        taskUpdateTimeFcn();
+    });
+    taskUpdateTimeFcn();
+
+    // Hide loading animation
+    commands.guio("@hls 500");
+
+    // All of the above is sent with a single write at the end of the
+    // event loop iteration
+}
+
+Application::~Application ()
+{
+    loop.removeTimer(timerUpdateTime);
+}
+
+
+void Application::taskUpdateTimeFcn ()
+{
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    LOG_DEBUG("Updating time: %s", timestamp);
+    bridge.commands().guiof("@lbTime2 TXT:\"%s\"", timestamp);
+}
+
+void Application::handleLine (std::string_view line)
+{
+    LOG_DEBUG("Processing line: %.*s", (int)line.size(), line.data());
+
+    std::string_view uid = line.substr(0, line.find(' '));
+    bool ackRequested = !uid.empty() && uid[0] == '?';
+    if (ackRequested) {
+        uid.remove_prefix(1);
+    }
+
+    CommandBuilder &commands = bridge.commands();
+
+    if (uid == "@tg1") {
+        // Toggle 'tg1' toggled
+        if (ackRequested) {
+            commands.guio("@tg1 CRE:1"); // send ACK
+        }
+
+        int state = 0;
+        size_t sep = line.find(' ');
+        if (sep != std::string_view::npos) {
+            state = atoi(std::string(line.substr(sep + 1)).c_str());
+        }
+        LOG_INFO("Toggle state update: %d", state);
+
+        count++;
+        globalCount++;
+
+        // Update toggle count labels
+        commands.guiof("@lbCount1 TXT:\"Toggles (session): %u\"", count);
+        commands.guiof("@lbCount2 TXT:\"Toggles (total): %u\"", globalCount);
+    } else if (uid == "@btExit") {
+        // Close button pressed
+        if (ackRequested) {
+            commands.guio("@btExit CRE:1"); // send ACK
+        }
+
+        LOG_INFO("Exit button pressed!");
+
+        // Shutdown
+        shutdown();
+    }
+}
+
+void Application::shutdown ()
+{
+    LOG_INFO("Shutting down application instance...");
+
+    active = false;
+
+    // Cancel the time update task
+    loop.removeTimer(timerUpdateTime);
+    timerUpdateTime = -1;
+
+    // Reset the UI
+    bridge.commands().guio("@cls");
+    bridge.commands().guio("@clh");
+}
+
+
+static void usage (const char *program)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "Toggle counter GUI-O demo.\n"
+        "\n"
+        "Options:\n"
+        "  --port <endpoint>     serial port or tcp:host:port (default: /dev/ttyUSB0)\n"
+        "  --baudrate <rate>     communication baudrate (default: 115200)\n"
+        "  --flow-control <mode> none, rtscts or xonxoff (default: none)\n"
+        "  --verbose             print debug messages\n",
+        program);
+}
+
+int main (int argc, char **argv)
+{
+    std::string port = "/dev/ttyUSB0";
+    unsigned baudrate = 115200;
+    std::string flowControl = "none";
+
+    static const option options[] = {
+        { "port", required_argument, nullptr, 'p' },
+        { "baudrate", required_argument, nullptr, 'b' },
+        { "flow-control", required_argument, nullptr, 'f' },
+        { "verbose", no_argument, nullptr, 'v' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:b:f:vh", options, nullptr)) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'b': baudrate = atoi(optarg); break;
+            case 'f': flowControl = optarg; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    try {
+        EventLoop loop;
+
+        LOG_INFO("Initializing serial communication...");
+        LOG_INFO("Serial port: %s", port.c_str());
+        LOG_INFO("Baud rate: %u", baudrate);
+
+        Bridge bridge(loop, Transport::open(loop, port, baudrate, flowControl == "rtscts"));
+        bridge.setSoftwareFlowControl(flowControl == "xonxoff");
+
+        std::unique_ptr<Application> program;
+
+        bridge.setGuioCallback([&] (int, std::string_view line) {
+            LOG_DEBUG("GUI-O message: %.*s", (int)line.size(), line.data());
+
+            if (line.compare(0, 6, "@init ") == 0) {
+                program.reset();
+                program.reset(new Application(loop, bridge, line));
+            } else if (program) {
+                if (program->active) {
+                    program->handleLine(line);
+                } else {
+                    LOG_WARNING("Received GUI-O message with inactive application instance!");
+                }
+            } else {
+                LOG_WARNING("Received GUI-O message with no application instance!");
+            }
+        });
+        bridge.setBridgeCallback([] (std::string_view line) {
+            LOG_INFO("ESP8266 message: %.*s", (int)line.size(), line.data());
+        });
+        bridge.setAuxCallback([] (std::string_view line) {
+            LOG_DEBUG("Aux message: %.*s", (int)line.size(), line.data());
+        });
+        bridge.setStatusCallback([] (StatusCode status) {
+            LOG_INFO("ESP8266 status: %s", statusName(status));
+        });
+        bridge.setClosedCallback([&loop] () {
+            LOG_INFO("Serial port closed!");
+            loop.stop();
+        });
+
+        // Periodic ping; once per minute
+        bridge.setPingInterval(60000);
+
+        LOG_INFO("Entering main loop...");
+        loop.run();
+    } catch (const std::exception &e) {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * GUI-O host library
+ * Fuzz target for the bridge's command parser (and the argument parsers
+ * of the configuration commands).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "command_parser.h"
+#include "parameters.h"
+#include "serial_framer.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+// Lines are framed as on the bridge, and each line is parsed the way
+// the program does it
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    SerialFramer framer;
+
+    for (size_t i = 0; i < size; i++) {
+        if (!framer.feed(data[i])) {
+            continue;
+        }
+
+        char *line = framer.line();
+        size_t length = framer.length();
+
+        char *args = nullptr;
+        Command command = command_parse(line, &args);
+        if (command == COMMAND_NONE) {
+            continue;
+        }
+        if (command < 0 || command >= COMMANDS || !args || args < line || args > line + length) {
+            abort();
+        }
+
+        // Arguments of the configuration commands; the results must be
+        // within the limits of the parameters they are stored into
+        if (command == COMMAND_MQTT) {
+            command_mqtt_args_t mqtt;
+            if (command_parse_mqtt_args(args, &mqtt) && mqtt.port == 0) {
+                abort();
+            }
+        } else if (command == COMMAND_BROKER) {
+            command_broker_args_t broker;
+            if (command_parse_broker_args(args, &broker)) {
+                if (broker.index < 1 || broker.index > _GUIO_MQTT_BACKUP_BROKERS || !memchr(broker.hostName, 0, sizeof(broker.hostName))) {
+                    abort();
+                }
+                if (!broker.hostName[0] && broker.port) {
+                    abort();
+                }
+            }
+        } else if (command == COMMAND_CHANNEL) {
+            command_channel_args_t channel;
+            if (command_parse_channel_args(args, &channel)) {
+                if (channel.channel < 1 || channel.channel >= _GUIO_CHANNELS) {
+                    abort();
+                }
+                if (strlen(channel.subscribeTopic) >= sizeof(parameters_t::channels[0].subscribeTopic)
+                    || strlen(channel.publishTopic) >= sizeof(parameters_t::channels[0].publishTopic)
+                    || !channel.subscribeTopic[0] != !channel.publishTopic[0]) {
+                    abort();
+                }
+            }
+        } else if (command == COMMAND_COMPRESS) {
+            command_compress_args_t compress;
+            if (command_parse_compress_args(args, &compress)) {
+                if (compress.action > COMPRESS_ACTION_STATS || compress.mode > 3) {
+                    abort();
+                }
+            }
+        }
+    }
+
+    return 0;
+}
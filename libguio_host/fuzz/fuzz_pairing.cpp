@@ -0,0 +1,60 @@
+/*
+ * GUI-O host library
+ * Fuzz target for the bridge's pairing request handler.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pairing.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+static bool terminated (const char *buffer, size_t size)
+{
+    return memchr(buffer, 0, size) != nullptr;
+}
+
+
+// The request body is deserialized with the same document capacity as
+// used by AsyncCallbackJsonWebHandler
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    DynamicJsonDocument document(1024);
+    if (deserializeJson(document, (const char *)data, size)) {
+        return 0;
+    }
+
+    parameters_t params;
+    parameters_init(&params);
+
+    char errorMessage[256];
+    JsonVariant json = document.as<JsonVariant>();
+    if (pairing_parse_request(json, &params, errorMessage, sizeof(errorMessage))) {
+        // All string fields must remain terminated
+        if (!terminated(params.networkSsid, sizeof(params.networkSsid))
+            || !terminated(params.networkPassword, sizeof(params.networkPassword))
+            || !terminated(params.mqttHostName, sizeof(params.mqttHostName))
+            || !terminated(params.mqttUserName, sizeof(params.mqttUserName))
+            || !terminated(params.mqttUserPassword, sizeof(params.mqttUserPassword))
+            || !terminated(params.subscribeTopic, sizeof(params.subscribeTopic))
+            || !terminated(params.publishTopic, sizeof(params.publishTopic))) {
+            abort();
+        }
+        for (const auto &broker : params.mqttBackupBrokers) {
+            if (!terminated(broker.hostName, sizeof(broker.hostName))) {
+                abort();
+            }
+        }
+        if (!params.configured || params.mqttPort == 0) {
+            abort();
+        }
+    } else if (params.configured || !terminated(errorMessage, sizeof(errorMessage))) {
+        abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * GUI-O host library
+ * Fuzz target for the payload codec (shared with the bridge).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "payload_codec.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+// The input is decompressed as a payload received from the peer
+// (prefixed, if needed); it is also compressed as a message from the
+// back-end, and must survive the round trip
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    static PayloadCodec codec;
+
+    if (size > 2 * PAYLOAD_CODEC_MAX_MESSAGE) {
+        return 0;
+    }
+
+    char payload[2 * PAYLOAD_CODEC_MAX_MESSAGE + 1];
+    size_t length = size;
+    memcpy(payload, data, size);
+    if (!PayloadCodec::isCompressed(payload, length)) {
+        memmove(payload + 1, payload, length++);
+        payload[0] = PAYLOAD_CODEC_PREFIX;
+    }
+
+    // Exact-size output buffer, so that overflows are caught by ASan
+    char *decoded = (char *)malloc(PAYLOAD_CODEC_MAX_MESSAGE);
+    int decodedLength = PayloadCodec::decompress(payload, length, decoded, PAYLOAD_CODEC_MAX_MESSAGE);
+    if (decodedLength < -1 || decodedLength > PAYLOAD_CODEC_MAX_MESSAGE) {
+        abort();
+    }
+
+    // Round trip
+    const char *message = (const char *)data;
+    char *compressed = (char *)malloc(PAYLOAD_CODEC_MAX_MESSAGE);
+    size_t compressedLength = codec.compress(message, size, compressed, PAYLOAD_CODEC_MAX_MESSAGE);
+    if (compressedLength) {
+        if (compressedLength >= size || !PayloadCodec::isCompressed(compressed, compressedLength)) {
+            abort();
+        }
+        for (size_t i = 0; i < compressedLength; i++) {
+            uint8_t c = compressed[i];
+            if (c == 0x00 || c == '\n' || c == '\r' || c == 0x11 || c == 0x13) {
+                abort();
+            }
+        }
+
+        decodedLength = PayloadCodec::decompress(compressed, compressedLength, decoded, size);
+        if (decodedLength != (int)size || memcmp(decoded, message, size) != 0) {
+            abort();
+        }
+    }
+
+    free(compressed);
+    free(decoded);
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * GUI-O host library
+ * Fuzz target for the bridge's serial line framer.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "serial_framer.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    SerialFramer framer;
+
+    for (size_t i = 0; i < size; i++) {
+        if (!framer.feed(data[i])) {
+            if (framer.length() > 255) {
+                abort();
+            }
+            continue;
+        }
+
+        // Complete line: terminated, without line ending
+        const char *line = framer.line();
+        size_t length = framer.length();
+        if (length > 255 || line[length] != 0 || memchr(line, '\n', length)) {
+            abort();
+        }
+        if (length > 0 && line[length - 1] == '\r') {
+            abort();
+        }
+    }
+
+    return 0;
+}
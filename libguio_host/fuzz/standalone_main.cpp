@@ -0,0 +1,65 @@
+/*
+ * GUI-O host library
+ * Driver for the fuzz targets when libFuzzer is not available; runs
+ * the target on the given files (e.g., the seed corpus).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+
+static bool runFile (const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "ERROR: cannot read %s\n", path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return true;
+}
+
+int main (int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file|directory>...\n", argv[0]);
+        return 1;
+    }
+
+    unsigned int inputs = 0;
+    for (int i = 1; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (const auto &entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    if (!runFile(entry.path())) {
+                        return 1;
+                    }
+                    inputs++;
+                }
+            }
+        } else {
+            if (!runFile(path)) {
+                return 1;
+            }
+            inputs++;
+        }
+    }
+
+    printf("Executed %u inputs\n", inputs);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * GUI-O host library
+ * Client for the GUI-O ESP8266 bridge.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__BRIDGE_H
+#define GUIO_HOST__BRIDGE_H
+
+#include "guio/command_builder.h"
+#include "guio/event_loop.h"
+#include "guio/line_splitter.h"
+#include "guio/transport.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+class PayloadCodec;
+
+
+namespace guio {
+
+// Keep in sync with definitions in bridge's program_base.h
+enum StatusCode
+{
+    // STA mode
+    STATUS_STA_READY  = 0, // ready & fully operational
+    STATUS_STA_NOSUB  = 1, // connected to both WiFi and MQTT, but MQTT subscribe failed
+    STATUS_STA_NOMQTT = 2, // connected to WiFi, but not connected to MQTT
+    STATUS_STA_NOWIFI = 3, // not connected to WiFi
+    // AP mode
+    STATUS_AP_READY = 100, // in AP mode, ready to be paired
+
+    STATUS_UNKNOWN = 255, // unknown status (also: bridge not responding)
+};
+
+const char *statusName (StatusCode status);
+
+
+struct bridge_stats_t
+{
+    uint64_t linesReceived;
+    uint64_t linesSent;
+    uint64_t flushes; // batches handed over to transport
+    uint32_t pingsSent;
+    uint32_t pongsReceived;
+    // Pass-through payload compression (sent messages)
+    uint64_t plainBytes;
+    uint64_t codedBytes;
+};
+
+
+class Bridge
+{
+public:
+    using GuioCallback = std::function<void (int channel, std::string_view message)>;
+    using LineCallback = std::function<void (std::string_view line)>;
+    using StatusCallback = std::function<void (StatusCode status)>;
+    using PongCallback = std::function<void (StatusCode status, std::chrono::microseconds rtt)>;
+    using Callback = std::function<void ()>;
+
+    Bridge (EventLoop &loop, std::unique_ptr<Transport> transport);
+    ~Bridge ();
+
+    Bridge (const Bridge &) = delete;
+    Bridge &operator= (const Bridge &) = delete;
+
+    // GUI-O message (without $-prefix and channel tag; channel is -1
+    // for untagged lines)
+    void setGuioCallback (GuioCallback callback);
+    // !-prefixed line, other than !PONG
+    void setBridgeCallback (LineCallback callback);
+    // Auxiliary line (e.g., bridge's debug output)
+    void setAuxCallback (LineCallback callback);
+    void setStatusCallback (StatusCallback callback);
+    void setPongCallback (PongCallback callback);
+    // Back-pressure was released; see congested()
+    void setWritableCallback (Callback callback);
+    void setClosedCallback (Callback callback);
+
+    // Commands are batched, and flushed with a single write at the end
+    // of the event loop iteration (or explicitly, via flush())
+    CommandBuilder &commands ();
+    void flush ();
+
+    // Output is backed up (e.g., the bridge paused us); producers should
+    // hold back until the writable callback
+    bool congested () const;
+
+    // Periodic !PING; a missing !PONG by the next ping sets the status
+    // to STATUS_UNKNOWN. 0 disables the periodic ping.
+    void setPingInterval (uint32_t intervalMs);
+    void ping ();
+    StatusCode getStatus () const;
+
+    // Handle XON/XOFF from the bridge (_GUIO_FLOW_SOFTWARE)
+    void setSoftwareFlowControl (bool enabled);
+
+    // Negotiate compression of pass-through messages on the serial leg
+    // (!COMPRESS); renegotiated whenever the bridge becomes ready.
+    // Compressed messages from the bridge are always accepted.
+    void setCompression (bool enabled);
+    bool isCompressionActive () const;
+
+    Transport &getTransport ();
+    const bridge_stats_t &getStats () const;
+
+protected:
+    void handleReadable ();
+    void handleLine (std::string_view line);
+    void handlePong (std::string_view args);
+    void taskPingFcn ();
+    void setStatus (StatusCode status);
+    size_t filterFlowControl (char *data, size_t size);
+    void negotiateCompression ();
+    void handleCompressReply (std::string_view args);
+    void compressCommands ();
+
+protected:
+    EventLoop &loop;
+    std::unique_ptr<Transport> transport;
+
+    LineSplitter splitter;
+    CommandBuilder builder;
+
+    GuioCallback guioCallback;
+    LineCallback bridgeCallback;
+    LineCallback auxCallback;
+    StatusCallback statusCallback;
+    PongCallback pongCallback;
+    Callback closedCallback;
+
+    StatusCode status;
+    int idleCallback;
+    int pingTimer;
+    std::deque<std::chrono::steady_clock::time_point> pendingPings;
+
+    bool softwareFlowControl;
+
+    std::unique_ptr<PayloadCodec> codec;
+    bool compressionRequested;
+    bool compressionActive;
+    std::vector<char> encoded; // compressed batch
+    std::vector<char> encodeBuffer; // compressed payload of a command
+    std::vector<char> decodeBuffer; // decompressed line (passed to the callback, which may flush)
+
+    bridge_stats_t stats;
+};
+
+} // guio
+
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * GUI-O host library
+ * Batching command builder.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__COMMAND_BUILDER_H
+#define GUIO_HOST__COMMAND_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+namespace guio {
+
+// Accumulates CRLF-terminated lines in a single contiguous buffer, so
+// that any number of commands can be sent with a single write.
+class CommandBuilder
+{
+public:
+    CommandBuilder ();
+
+    // Pass-through channel for subsequent GUI-O commands; -1 (default)
+    // for untagged ($-prefixed) lines, otherwise $<channel>: tag
+    CommandBuilder &channel (int channel);
+
+    // GUI-O command (without the $-prefix), e.g., "@cls"
+    CommandBuilder &guio (std::string_view command);
+    CommandBuilder &guiof (const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Bridge command, including the !-prefix, e.g., "!PING"
+    CommandBuilder &bridge (std::string_view command);
+
+    const char *data () const;
+    size_t size () const;
+    bool empty () const;
+    uint32_t count () const; // number of lines
+    void clear ();
+
+protected:
+    void appendPrefix ();
+
+protected:
+    std::vector<char> buffer;
+    int currentChannel;
+    uint32_t lines;
+};
+
+} // guio
+
+
+#endif
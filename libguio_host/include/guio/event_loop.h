@@ -0,0 +1,76 @@
+/*
+ * GUI-O host library
+ * epoll-based event loop.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__EVENT_LOOP_H
+#define GUIO_HOST__EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace guio {
+
+class EventLoop
+{
+public:
+    // Called with the epoll event mask (EPOLLIN, EPOLLOUT, ...)
+    using IoCallback = std::function<void (uint32_t events)>;
+    using Callback = std::function<void ()>;
+
+    EventLoop ();
+    ~EventLoop ();
+
+    EventLoop (const EventLoop &) = delete;
+    EventLoop &operator= (const EventLoop &) = delete;
+
+    // File descriptor watches
+    void add (int fd, uint32_t events, IoCallback callback);
+    void modify (int fd, uint32_t events);
+    void remove (int fd);
+
+    // Periodic timer; returns timer ID (the underlying timerfd)
+    int addTimer (uint32_t intervalMs, Callback callback);
+    void removeTimer (int timer);
+
+    // Called once per loop iteration, after the events of the previous
+    // iteration have been dispatched and before waiting for new ones
+    // (e.g., to flush batched writes); returns ID
+    int addIdleCallback (Callback callback);
+    void removeIdleCallback (int id);
+
+    // Called once, in the next loop iteration (without waiting for events)
+    void defer (Callback callback);
+
+    void run ();
+    void stop ();
+
+protected:
+    void dispatch (int fd, uint32_t events);
+
+protected:
+    int epollFd;
+    bool running;
+
+    std::unordered_map<int, std::shared_ptr<IoCallback>> watches;
+    std::unordered_set<int> timers;
+    std::map<int, std::shared_ptr<Callback>> idleCallbacks;
+    std::vector<std::pair<int, std::shared_ptr<Callback>>> idleSnapshot;
+    int nextIdleId;
+    std::vector<Callback> deferredCallbacks;
+};
+
+} // guio
+
+
+#endif
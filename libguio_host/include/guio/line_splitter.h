@@ -0,0 +1,56 @@
+/*
+ * GUI-O host library
+ * Zero-copy line splitter.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__LINE_SPLITTER_H
+#define GUIO_HOST__LINE_SPLITTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+namespace guio {
+
+// Splits the incoming byte stream into LF- or CRLF-terminated lines.
+// The data is read directly into the splitter's buffer, and the lines
+// are returned as views into it; a partial line is moved to the front
+// of the buffer only when space is needed for new data.
+class LineSplitter
+{
+public:
+    // The capacity is also the maximum line length; longer lines are
+    // truncated (and the remainder discarded)
+    explicit LineSplitter (size_t capacity = 4096);
+
+    // Space for new data
+    char *writePtr ();
+    size_t writeSpace ();
+    void commit (size_t size);
+
+    // Next complete line, without the line terminator; the view remains
+    // valid until the next call to writePtr()
+    bool next (std::string_view &line);
+
+    uint32_t getTruncatedLines () const;
+
+protected:
+    std::vector<char> buffer;
+    size_t start; // start of unconsumed data
+    size_t scan; // position up to which there is no line terminator
+    size_t end; // end of valid data
+    bool discarding; // discarding remainder of a truncated line
+
+    uint32_t truncatedLines;
+};
+
+} // guio
+
+
+#endif
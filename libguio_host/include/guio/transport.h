@@ -0,0 +1,138 @@
+/*
+ * GUI-O host library
+ * Non-blocking serial/TCP transport.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__TRANSPORT_H
+#define GUIO_HOST__TRANSPORT_H
+
+#include "guio/event_loop.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+
+namespace guio {
+
+struct transport_stats_t
+{
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t readCalls; // read() syscalls
+    uint64_t writeCalls; // write() syscalls
+};
+
+
+class Transport
+{
+public:
+    using Callback = std::function<void ()>;
+
+    // Serial port (raw mode, 8N1), optionally with RTS/CTS flow control
+    static std::unique_ptr<Transport> openSerial (EventLoop &loop, const std::string &device, unsigned baudrate, bool hardwareFlowControl = false);
+    // TCP connection (e.g., to a serial-to-network server). The connection
+    // is established asynchronously; data written in the meantime is
+    // queued, and failure to connect is reported via closed callback.
+    static std::unique_ptr<Transport> openTcp (EventLoop &loop, const std::string &host, uint16_t port);
+    // "tcp:host:port" or path to serial device
+    static std::unique_ptr<Transport> open (EventLoop &loop, const std::string &endpoint, unsigned baudrate, bool hardwareFlowControl = false);
+
+    ~Transport ();
+
+    Transport (const Transport &) = delete;
+    Transport &operator= (const Transport &) = delete;
+
+    // Data is available; call read() until it returns 0
+    void setReadCallback (Callback callback);
+    // Queued output dropped below low watermark after exceeding the
+    // high one (i.e., back-pressure was released)
+    void setWritableCallback (Callback callback);
+    // Connection closed or failed
+    void setClosedCallback (Callback callback);
+
+    // Returns number of bytes read, 0 if no data is available, and -1
+    // if the connection is closed
+    ssize_t read (char *buffer, size_t size);
+
+    // Writes the data, or queues whatever cannot be written immediately;
+    // data is never dropped, so the caller should observe congested().
+    // Returns false if the connection is closed.
+    bool write (const char *data, size_t size);
+
+    size_t pending () const;
+    bool congested () const;
+    void setWatermarks (size_t low, size_t high);
+
+    // Hold back the output (e.g., upon XOFF from the peer)
+    void setPaused (bool paused);
+    bool isPaused () const;
+
+    bool isOpen () const;
+    bool isConnecting () const;
+    void close ();
+
+    const transport_stats_t &getStats () const;
+
+protected:
+    Transport (EventLoop &loop, int fd, bool eofOnEmptyRead);
+
+    void addToLoop (uint32_t events);
+    bool connectNext ();
+    void handleConnect ();
+
+    void handleEvents (uint32_t events);
+    bool flushPending ();
+    void updateEvents ();
+    void closeAndNotify ();
+
+protected:
+    EventLoop &loop;
+    int fd;
+    bool eofOnEmptyRead; // stream sockets signal EOF with empty read
+
+    // Non-blocking connect; addresses are tried in order
+    struct address_t
+    {
+        int family;
+        int socktype;
+        int protocol;
+        sockaddr_storage addr;
+        socklen_t addrlen;
+    };
+
+    std::vector<address_t> addresses;
+    size_t nextAddress;
+    bool connecting;
+    int connectError; // errno of last failed attempt
+
+    // Output queue; data in [txHead, txBuffer.size()) is pending
+    std::vector<char> txBuffer;
+    size_t txHead;
+    size_t lowWatermark;
+    size_t highWatermark;
+    bool wasCongested;
+    bool paused;
+    bool pollingOut;
+
+    Callback readCallback;
+    Callback writableCallback;
+    Callback closedCallback;
+
+    transport_stats_t stats;
+};
+
+} // guio
+
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * GUI-O host library
+ * Client for the GUI-O ESP8266 bridge.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/bridge.h"
+
+#include "payload_codec.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+
+namespace guio {
+
+const char *statusName (StatusCode status)
+{
+    switch (status) {
+        case STATUS_STA_READY: return "STATUS_STA_READY";
+        case STATUS_STA_NOSUB: return "STATUS_STA_NOSUB";
+        case STATUS_STA_NOMQTT: return "STATUS_STA_NOMQTT";
+        case STATUS_STA_NOWIFI: return "STATUS_STA_NOWIFI";
+        case STATUS_AP_READY: return "STATUS_AP_READY";
+        default: return "STATUS_UNKNOWN";
+    }
+}
+
+
+Bridge::Bridge (EventLoop &loop, std::unique_ptr<Transport> transport)
+    : loop(loop),
+      transport(std::move(transport)),
+      status(STATUS_UNKNOWN),
+      idleCallback(-1),
+      pingTimer(-1),
+      softwareFlowControl(false),
+      compressionRequested(false),
+      compressionActive(false),
+      stats()
+{
+    this->transport->setReadCallback([this] () {
+        handleReadable();
+    });
+    this->transport->setClosedCallback([this] () {
+        setStatus(STATUS_UNKNOWN);
+        if (closedCallback) {
+            closedCallback();
+        }
+    });
+
+    // Flush the batched commands once per loop iteration
+    idleCallback = loop.addIdleCallback([this] () {
+        flush();
+    });
+}
+
+Bridge::~Bridge ()
+{
+    setPingInterval(0);
+    loop.removeIdleCallback(idleCallback);
+}
+
+
+void Bridge::setGuioCallback (GuioCallback callback)
+{
+    guioCallback = std::move(callback);
+}
+
+void Bridge::setBridgeCallback (LineCallback callback)
+{
+    bridgeCallback = std::move(callback);
+}
+
+void Bridge::setAuxCallback (LineCallback callback)
+{
+    auxCallback = std::move(callback);
+}
+
+void Bridge::setStatusCallback (StatusCallback callback)
+{
+    statusCallback = std::move(callback);
+}
+
+void Bridge::setPongCallback (PongCallback callback)
+{
+    pongCallback = std::move(callback);
+}
+
+void Bridge::setWritableCallback (Callback callback)
+{
+    transport->setWritableCallback(std::move(callback));
+}
+
+void Bridge::setClosedCallback (Callback callback)
+{
+    closedCallback = std::move(callback);
+}
+
+
+CommandBuilder &Bridge::commands ()
+{
+    return builder;
+}
+
+void Bridge::flush ()
+{
+    if (builder.empty() || !transport->isOpen()) {
+        return;
+    }
+
+    if (compressionActive) {
+        compressCommands();
+        transport->write(encoded.data(), encoded.size());
+    } else {
+        transport->write(builder.data(), builder.size());
+    }
+    stats.linesSent += builder.count();
+    stats.flushes++;
+    builder.clear();
+}
+
+bool Bridge::congested () const
+{
+    return transport->congested();
+}
+
+
+void Bridge::setPingInterval (uint32_t intervalMs)
+{
+    if (pingTimer >= 0) {
+        loop.removeTimer(pingTimer);
+        pingTimer = -1;
+    }
+
+    if (intervalMs) {
+        pingTimer = loop.addTimer(intervalMs, [this] () {
+            taskPingFcn();
+        });
+        ping();
+    }
+}
+
+void Bridge::ping ()
+{
+    builder.bridge("!PING");
+    pendingPings.push_back(std::chrono::steady_clock::now());
+    stats.pingsSent++;
+}
+
+StatusCode Bridge::getStatus () const
+{
+    return status;
+}
+
+
+void Bridge::setSoftwareFlowControl (bool enabled)
+{
+    softwareFlowControl = enabled;
+    if (!enabled) {
+        transport->setPaused(false);
+    }
+}
+
+
+void Bridge::setCompression (bool enabled)
+{
+    compressionRequested = enabled;
+
+    if (enabled) {
+        if (!codec) {
+            codec.reset(new PayloadCodec());
+        }
+        negotiateCompression();
+    } else {
+        compressionActive = false;
+        builder.bridge("!COMPRESS OFF");
+    }
+}
+
+bool Bridge::isCompressionActive () const
+{
+    return compressionActive;
+}
+
+
+Transport &Bridge::getTransport ()
+{
+    return *transport;
+}
+
+const bridge_stats_t &Bridge::getStats () const
+{
+    return stats;
+}
+
+
+void Bridge::handleReadable ()
+{
+    while (true) {
+        // Read directly into the splitter's buffer
+        char *data = splitter.writePtr();
+        ssize_t len = transport->read(data, splitter.writeSpace());
+        if (len <= 0) {
+            // Not reported if closed explicitly (e.g., from a callback)
+            if (len < 0 && transport->isOpen()) {
+                transport->close();
+                setStatus(STATUS_UNKNOWN);
+                if (closedCallback) {
+                    closedCallback();
+                }
+            }
+            break;
+        }
+
+        if (softwareFlowControl) {
+            len = filterFlowControl(data, len);
+        }
+        splitter.commit(len);
+
+        std::string_view line;
+        while (splitter.next(line)) {
+            handleLine(line);
+        }
+    }
+}
+
+void Bridge::handleLine (std::string_view line)
+{
+    if (line.empty()) {
+        return;
+    }
+
+    stats.linesReceived++;
+
+    if (line[0] == '$') {
+        // GUI-O pass-through, possibly with channel tag
+        line.remove_prefix(1);
+        int channel = -1;
+        if (line.size() >= 2 && line[0] >= '0' && line[0] <= '9' && line[1] == ':') {
+            channel = line[0] - '0';
+            line.remove_prefix(2);
+        }
+        if (PayloadCodec::isCompressed(line.data(), line.size())) {
+            decodeBuffer.resize(PAYLOAD_CODEC_MAX_MESSAGE);
+            int length = PayloadCodec::decompress(line.data(), line.size(), decodeBuffer.data(), decodeBuffer.size());
+            if (length < 0) {
+                return; // malformed
+            }
+            line = std::string_view(decodeBuffer.data(), length);
+        }
+        if (guioCallback) {
+            guioCallback(channel, line);
+        }
+    } else if (line[0] == '!') {
+        if (line.compare(0, 6, "!PONG ") == 0) {
+            handlePong(line.substr(6));
+        } else if (line.compare(0, 10, "!COMPRESS ") == 0 && line.compare(10, 6, "STATS ") != 0) {
+            handleCompressReply(line.substr(10));
+        } else if (bridgeCallback) {
+            bridgeCallback(line);
+        }
+    } else if (auxCallback) {
+        auxCallback(line);
+    }
+}
+
+void Bridge::handlePong (std::string_view args)
+{
+    stats.pongsReceived++;
+
+    int value = STATUS_UNKNOWN;
+    std::from_chars(args.data(), args.data() + args.size(), value);
+    StatusCode code = (StatusCode)value;
+
+    // Pongs are returned in order
+    std::chrono::microseconds rtt(0);
+    if (!pendingPings.empty()) {
+        rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pendingPings.front());
+        pendingPings.pop_front();
+    }
+
+    setStatus(code);
+
+    if (pongCallback) {
+        pongCallback(code, rtt);
+    }
+}
+
+void Bridge::taskPingFcn ()
+{
+    // No response since the last ping
+    if (!pendingPings.empty()) {
+        pendingPings.clear();
+        setStatus(STATUS_UNKNOWN);
+    }
+
+    ping();
+}
+
+void Bridge::setStatus (StatusCode status)
+{
+    if (status == this->status) {
+        return;
+    }
+
+    this->status = status;
+
+    // Bridge might have been restarted
+    if (status == STATUS_STA_READY && compressionRequested) {
+        negotiateCompression();
+    }
+
+    if (statusCallback) {
+        statusCallback(status);
+    }
+}
+
+
+size_t Bridge::filterFlowControl (char *data, size_t size)
+{
+    // Apply the last XON/XOFF, and remove them from the data
+    char *end = std::remove_if(data, data + size, [this] (char c) {
+        if (c == 0x13) {
+            transport->setPaused(true);
+            return true;
+        } else if (c == 0x11) {
+            transport->setPaused(false);
+            return true;
+        }
+        return false;
+    });
+
+    return end - data;
+}
+
+
+void Bridge::negotiateCompression ()
+{
+    char command[32];
+    snprintf(command, sizeof(command), "!COMPRESS SERIAL %d", PAYLOAD_CODEC_VERSION);
+    builder.bridge(command);
+}
+
+void Bridge::handleCompressReply (std::string_view args)
+{
+    // <mode> <version>; SERIAL or BOTH with matching version means that
+    // the bridge is compression-aware on the serial leg
+    std::string_view mode = args.substr(0, args.find(' '));
+    int version = 0;
+    if (mode.size() < args.size()) {
+        std::string_view versionArg = args.substr(mode.size() + 1);
+        std::from_chars(versionArg.data(), versionArg.data() + versionArg.size(), version);
+    }
+
+    compressionActive = compressionRequested && version == PAYLOAD_CODEC_VERSION && (mode == "SERIAL" || mode == "BOTH");
+}
+
+void Bridge::compressCommands ()
+{
+    // Compress the payload of each pass-through line in the batch
+    encoded.clear();
+    encodeBuffer.resize(PAYLOAD_CODEC_MAX_MESSAGE);
+
+    const char *data = builder.data();
+    const char *end = data + builder.size();
+    while (data < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(data, '\n', end - data));
+        lineEnd = lineEnd ? lineEnd + 1 : end;
+
+        // Payload, without the prefix/tag and CRLF
+        size_t prefix = 0;
+        if (data[0] == '$') {
+            prefix = (lineEnd - data >= 3 && data[1] >= '0' && data[1] <= '9' && data[2] == ':') ? 3 : 1;
+        }
+        const char *payload = data + prefix;
+        size_t payloadLength = lineEnd - payload;
+        while (payloadLength && (payload[payloadLength - 1] == '\n' || payload[payloadLength - 1] == '\r')) {
+            payloadLength--;
+        }
+
+        size_t compressedLength = 0;
+        if (prefix) {
+            compressedLength = codec->compress(payload, payloadLength, encodeBuffer.data(), encodeBuffer.size());
+            stats.plainBytes += payloadLength;
+            stats.codedBytes += compressedLength ? compressedLength : payloadLength;
+        }
+
+        if (compressedLength) {
+            encoded.insert(encoded.end(), data, payload);
+            encoded.insert(encoded.end(), encodeBuffer.data(), encodeBuffer.data() + compressedLength);
+            encoded.insert(encoded.end(), payload + payloadLength, lineEnd);
+        } else {
+            encoded.insert(encoded.end(), data, lineEnd);
+        }
+
+        data = lineEnd;
+    }
+}
+
+} // guio
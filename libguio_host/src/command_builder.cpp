@@ -0,0 +1,129 @@
+/*
+ * GUI-O host library
+ * Batching command builder.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/command_builder.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+
+namespace guio {
+
+CommandBuilder::CommandBuilder ()
+    : currentChannel(-1),
+      lines(0)
+{
+    buffer.reserve(4096);
+}
+
+
+CommandBuilder &CommandBuilder::channel (int channel)
+{
+    currentChannel = channel;
+    return *this;
+}
+
+
+CommandBuilder &CommandBuilder::guio (std::string_view command)
+{
+    appendPrefix();
+    buffer.insert(buffer.end(), command.begin(), command.end());
+    buffer.push_back('\r');
+    buffer.push_back('\n');
+    lines++;
+
+    return *this;
+}
+
+CommandBuilder &CommandBuilder::guiof (const char *format, ...)
+{
+    appendPrefix();
+
+    // Format directly into the buffer; retry once with enough space
+    size_t offset = buffer.size();
+    size_t space = buffer.capacity() - offset;
+    if (space < 64) {
+        space = 256;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        buffer.resize(offset + space);
+
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buffer.data() + offset, space, format, args);
+        va_end(args);
+
+        if (len < 0) {
+            len = 0;
+        }
+        if ((size_t)len < space) {
+            buffer.resize(offset + len);
+            break;
+        }
+        space = len + 1;
+    }
+
+    buffer.push_back('\r');
+    buffer.push_back('\n');
+    lines++;
+
+    return *this;
+}
+
+
+CommandBuilder &CommandBuilder::bridge (std::string_view command)
+{
+    buffer.insert(buffer.end(), command.begin(), command.end());
+    buffer.push_back('\r');
+    buffer.push_back('\n');
+    lines++;
+
+    return *this;
+}
+
+
+const char *CommandBuilder::data () const
+{
+    return buffer.data();
+}
+
+size_t CommandBuilder::size () const
+{
+    return buffer.size();
+}
+
+bool CommandBuilder::empty () const
+{
+    return buffer.empty();
+}
+
+uint32_t CommandBuilder::count () const
+{
+    return lines;
+}
+
+void CommandBuilder::clear ()
+{
+    // Keeps the capacity
+    buffer.clear();
+    lines = 0;
+}
+
+
+void CommandBuilder::appendPrefix ()
+{
+    buffer.push_back('$');
+    if (currentChannel >= 0) {
+        buffer.push_back('0' + currentChannel);
+        buffer.push_back(':');
+    }
+}
+
+} // guio
@@ -0,0 +1,192 @@
+/*
+ * GUI-O host library
+ * epoll-based event loop.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/event_loop.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+
+namespace guio {
+
+EventLoop::EventLoop ()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      running(false),
+      nextIdleId(0)
+{
+    if (epollFd < 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+}
+
+EventLoop::~EventLoop ()
+{
+    for (int timer : timers) {
+        close(timer);
+    }
+    close(epollFd);
+}
+
+
+void EventLoop::add (int fd, uint32_t events, IoCallback callback)
+{
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl(ADD)");
+    }
+
+    watches[fd] = std::make_shared<IoCallback>(std::move(callback));
+}
+
+void EventLoop::modify (int fd, uint32_t events)
+{
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl(MOD)");
+    }
+}
+
+void EventLoop::remove (int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    watches.erase(fd);
+}
+
+
+int EventLoop::addTimer (uint32_t intervalMs, Callback callback)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "timerfd_create");
+    }
+
+    itimerspec spec = {};
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    add(fd, EPOLLIN, [fd, callback] (uint32_t) {
+        // Consume the expiration count
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            callback();
+        }
+    });
+
+    timers.insert(fd);
+
+    return fd;
+}
+
+void EventLoop::removeTimer (int timer)
+{
+    if (!timers.erase(timer)) {
+        return;
+    }
+
+    remove(timer);
+    close(timer);
+}
+
+
+int EventLoop::addIdleCallback (Callback callback)
+{
+    int id = nextIdleId++;
+    idleCallbacks[id] = std::make_shared<Callback>(std::move(callback));
+    return id;
+}
+
+void EventLoop::removeIdleCallback (int id)
+{
+    idleCallbacks.erase(id);
+}
+
+void EventLoop::defer (Callback callback)
+{
+    deferredCallbacks.push_back(std::move(callback));
+}
+
+
+void EventLoop::run ()
+{
+    epoll_event events[32];
+
+    running = true;
+    while (running) {
+        if (!deferredCallbacks.empty()) {
+            std::vector<Callback> callbacks;
+            callbacks.swap(deferredCallbacks);
+            for (auto &callback : callbacks) {
+                callback();
+            }
+        }
+
+        // Run before blocking, so that whatever was produced by the
+        // previous iteration (or before the loop was started) is handled.
+        // Callbacks may add or remove idle callbacks (including
+        // themselves), so a snapshot is iterated; removed ones are
+        // skipped, and added ones run in the next iteration.
+        idleSnapshot.assign(idleCallbacks.begin(), idleCallbacks.end());
+        for (auto &callback : idleSnapshot) {
+            if (idleCallbacks.count(callback.first)) {
+                (*callback.second)();
+            }
+        }
+        idleSnapshot.clear();
+
+        if (!running) {
+            break;
+        }
+
+        // Do not block if there are deferred callbacks
+        int count = epoll_wait(epollFd, events, 32, deferredCallbacks.empty() ? -1 : 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+
+        for (int i = 0; i < count; i++) {
+            dispatch(events[i].data.fd, events[i].events);
+        }
+    }
+}
+
+void EventLoop::stop ()
+{
+    running = false;
+}
+
+
+void EventLoop::dispatch (int fd, uint32_t events)
+{
+    // The watch might be removed by an earlier callback in the same
+    // iteration, or by its own callback; hold a reference while calling
+    auto it = watches.find(fd);
+    if (it == watches.end()) {
+        return;
+    }
+
+    std::shared_ptr<IoCallback> callback = it->second;
+    (*callback)(events);
+}
+
+} // guio
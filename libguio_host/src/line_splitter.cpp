@@ -0,0 +1,103 @@
+/*
+ * GUI-O host library
+ * Zero-copy line splitter.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/line_splitter.h"
+
+#include <cstring>
+
+
+namespace guio {
+
+LineSplitter::LineSplitter (size_t capacity)
+    : buffer(capacity),
+      start(0),
+      scan(0),
+      end(0),
+      discarding(false),
+      truncatedLines(0)
+{
+}
+
+
+char *LineSplitter::writePtr ()
+{
+    if (start == end) {
+        // Everything consumed; free of charge
+        start = scan = end = 0;
+    } else if (start > 0 && buffer.size() - end < buffer.size() / 4) {
+        // Running out of space; move the partial line to the front
+        memmove(buffer.data(), buffer.data() + start, end - start);
+        scan -= start;
+        end -= start;
+        start = 0;
+    }
+
+    return buffer.data() + end;
+}
+
+size_t LineSplitter::writeSpace ()
+{
+    return buffer.size() - end;
+}
+
+void LineSplitter::commit (size_t size)
+{
+    end += size;
+}
+
+
+bool LineSplitter::next (std::string_view &line)
+{
+    while (true) {
+        const char *data = buffer.data();
+        const char *newline = static_cast<const char *>(memchr(data + scan, '\n', end - scan));
+
+        if (!newline) {
+            scan = end;
+
+            // Buffer is full, but there is no line terminator
+            if (start == 0 && end == buffer.size()) {
+                bool wasDiscarding = discarding;
+                start = scan = end = 0;
+                discarding = true;
+                if (!wasDiscarding) {
+                    truncatedLines++;
+                    line = std::string_view(data, buffer.size());
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t lineStart = start;
+        size_t lineEnd = newline - data;
+        start = scan = lineEnd + 1;
+
+        if (discarding) {
+            // Tail of a truncated line
+            discarding = false;
+            continue;
+        }
+
+        if (lineEnd > lineStart && data[lineEnd - 1] == '\r') {
+            lineEnd--;
+        }
+
+        line = std::string_view(data + lineStart, lineEnd - lineStart);
+        return true;
+    }
+}
+
+
+uint32_t LineSplitter::getTruncatedLines () const
+{
+    return truncatedLines;
+}
+
+} // guio
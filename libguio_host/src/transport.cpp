@@ -0,0 +1,462 @@
+/*
+ * GUI-O host library
+ * Non-blocking serial/TCP transport.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/transport.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace guio {
+
+static speed_t baudrateToSpeed (unsigned baudrate)
+{
+    switch (baudrate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        default: throw std::invalid_argument("Unsupported baud rate: " + std::to_string(baudrate));
+    }
+}
+
+
+std::unique_ptr<Transport> Transport::openSerial (EventLoop &loop, const std::string &device, unsigned baudrate, bool hardwareFlowControl)
+{
+    speed_t speed = baudrateToSpeed(baudrate);
+
+    int fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open(" + device + ")");
+    }
+
+    termios tty;
+    if (tcgetattr(fd, &tty) < 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "tcgetattr(" + device + ")");
+    }
+
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    tty.c_cflag |= CLOCAL | CREAD;
+    if (hardwareFlowControl) {
+        tty.c_cflag |= CRTSCTS;
+    } else {
+        tty.c_cflag &= ~CRTSCTS;
+    }
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    if (tcsetattr(fd, TCSANOW, &tty) < 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "tcsetattr(" + device + ")");
+    }
+
+    // Discard any stale data (e.g., the bootloader's message)
+    tcflush(fd, TCIOFLUSH);
+
+    return std::unique_ptr<Transport>(new Transport(loop, fd, false));
+}
+
+std::unique_ptr<Transport> Transport::openTcp (EventLoop &loop, const std::string &host, uint16_t port)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *result;
+    int ret = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+    if (ret != 0) {
+        throw std::runtime_error("getaddrinfo(" + host + "): " + gai_strerror(ret));
+    }
+
+    std::unique_ptr<Transport> transport(new Transport(loop, -1, true));
+    for (addrinfo *addr = result; addr; addr = addr->ai_next) {
+        address_t address = {};
+        address.family = addr->ai_family;
+        address.socktype = addr->ai_socktype;
+        address.protocol = addr->ai_protocol;
+        memcpy(&address.addr, addr->ai_addr, addr->ai_addrlen);
+        address.addrlen = addr->ai_addrlen;
+        transport->addresses.push_back(address);
+    }
+    freeaddrinfo(result);
+
+    // Fails right away only if none of the addresses can be tried
+    if (!transport->connectNext()) {
+        throw std::system_error(transport->connectError, std::generic_category(), "connect(" + host + ":" + std::to_string(port) + ")");
+    }
+
+    return transport;
+}
+
+std::unique_ptr<Transport> Transport::open (EventLoop &loop, const std::string &endpoint, unsigned baudrate, bool hardwareFlowControl)
+{
+    if (endpoint.compare(0, 4, "tcp:") == 0) {
+        size_t sep = endpoint.rfind(':');
+        if (sep <= 4) {
+            throw std::invalid_argument("Invalid TCP endpoint: " + endpoint);
+        }
+        return openTcp(loop, endpoint.substr(4, sep - 4), std::stoi(endpoint.substr(sep + 1)));
+    }
+
+    return openSerial(loop, endpoint, baudrate, hardwareFlowControl);
+}
+
+
+Transport::Transport (EventLoop &loop, int fd, bool eofOnEmptyRead)
+    : loop(loop),
+      fd(fd),
+      eofOnEmptyRead(eofOnEmptyRead),
+      nextAddress(0),
+      connecting(false),
+      connectError(0),
+      txHead(0),
+      lowWatermark(16 * 1024),
+      highWatermark(64 * 1024),
+      wasCongested(false),
+      paused(false),
+      pollingOut(false),
+      stats()
+{
+    if (fd >= 0) {
+        addToLoop(EPOLLIN);
+    }
+}
+
+Transport::~Transport ()
+{
+    close();
+}
+
+
+void Transport::addToLoop (uint32_t events)
+{
+    loop.add(fd, events, [this] (uint32_t events) {
+        handleEvents(events);
+    });
+}
+
+bool Transport::connectNext ()
+{
+    while (nextAddress < addresses.size()) {
+        const address_t &address = addresses[nextAddress++];
+
+        fd = socket(address.family, address.socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address.protocol);
+        if (fd < 0) {
+            connectError = errno;
+            continue;
+        }
+
+        // Writes are batched by the caller
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        if (::connect(fd, reinterpret_cast<const sockaddr *>(&address.addr), address.addrlen) == 0) {
+            connecting = false;
+            pollingOut = false;
+            addToLoop(EPOLLIN);
+            updateEvents(); // data written in the meantime
+            return true;
+        }
+        if (errno == EINPROGRESS) {
+            // Completion is signalled by EPOLLOUT
+            connecting = true;
+            addToLoop(EPOLLOUT);
+            return true;
+        }
+
+        connectError = errno;
+        ::close(fd);
+        fd = -1;
+    }
+
+    connecting = false;
+    return false;
+}
+
+void Transport::handleConnect ()
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        error = errno;
+    }
+
+    if (error == 0) {
+        connecting = false;
+        pollingOut = false;
+        loop.modify(fd, EPOLLIN);
+        if (!flushPending()) {
+            closeAndNotify();
+        }
+        return;
+    }
+
+    // Try the next address, if any
+    connectError = error;
+    loop.remove(fd);
+    ::close(fd);
+    fd = -1;
+
+    if (!connectNext()) {
+        closeAndNotify();
+    }
+}
+
+
+void Transport::setReadCallback (Callback callback)
+{
+    readCallback = std::move(callback);
+}
+
+void Transport::setWritableCallback (Callback callback)
+{
+    writableCallback = std::move(callback);
+}
+
+void Transport::setClosedCallback (Callback callback)
+{
+    closedCallback = std::move(callback);
+}
+
+
+ssize_t Transport::read (char *buffer, size_t size)
+{
+    if (fd < 0) {
+        return -1;
+    }
+    if (connecting) {
+        return 0;
+    }
+
+    ssize_t ret = ::read(fd, buffer, size);
+    stats.readCalls++;
+
+    if (ret > 0) {
+        stats.bytesRead += ret;
+        return ret;
+    }
+    if (ret == 0) {
+        // Serial ports also return empty reads when there is no data
+        // (e.g., VMIN/VTIME); their hang-up is reported via EPOLLHUP or
+        // EPOLLERR, or as EIO
+        return eofOnEmptyRead ? -1 : 0;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+    }
+    return -1;
+}
+
+bool Transport::write (const char *data, size_t size)
+{
+    if (fd < 0) {
+        return false;
+    }
+
+    // Write directly if nothing is queued; the remainder is queued
+    if (txHead == txBuffer.size() && !paused && !connecting) {
+        ssize_t ret = ::write(fd, data, size);
+        stats.writeCalls++;
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return false;
+            }
+            ret = 0;
+        }
+        stats.bytesWritten += ret;
+        data += ret;
+        size -= ret;
+
+        if (!size) {
+            return true;
+        }
+
+        txBuffer.clear();
+        txHead = 0;
+    }
+
+    txBuffer.insert(txBuffer.end(), data, data + size);
+    if (pending() >= highWatermark) {
+        wasCongested = true;
+    }
+    updateEvents();
+
+    return true;
+}
+
+size_t Transport::pending () const
+{
+    return txBuffer.size() - txHead;
+}
+
+bool Transport::congested () const
+{
+    return pending() >= highWatermark;
+}
+
+void Transport::setWatermarks (size_t low, size_t high)
+{
+    lowWatermark = low;
+    highWatermark = high;
+}
+
+
+void Transport::setPaused (bool paused)
+{
+    this->paused = paused;
+    updateEvents();
+}
+
+bool Transport::isPaused () const
+{
+    return paused;
+}
+
+
+bool Transport::isOpen () const
+{
+    return fd >= 0;
+}
+
+bool Transport::isConnecting () const
+{
+    return connecting;
+}
+
+void Transport::close ()
+{
+    connecting = false;
+    nextAddress = addresses.size();
+
+    if (fd < 0) {
+        return;
+    }
+
+    loop.remove(fd);
+    ::close(fd);
+    fd = -1;
+}
+
+void Transport::closeAndNotify ()
+{
+    close();
+    if (closedCallback) {
+        closedCallback();
+    }
+}
+
+
+const transport_stats_t &Transport::getStats () const
+{
+    return stats;
+}
+
+
+void Transport::handleEvents (uint32_t events)
+{
+    if (connecting) {
+        handleConnect();
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        if (!flushPending()) {
+            closeAndNotify();
+            return;
+        }
+    }
+
+    // On hang-up, the remaining data is still read; the connection is
+    // then closed, as the (level-triggered) hang-up would be reported
+    // again and again
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        if (readCallback) {
+            readCallback();
+        }
+
+        if ((events & (EPOLLHUP | EPOLLERR)) && fd >= 0) {
+            closeAndNotify();
+        }
+    }
+}
+
+bool Transport::flushPending ()
+{
+    while (!paused && txHead < txBuffer.size()) {
+        ssize_t ret = ::write(fd, txBuffer.data() + txHead, txBuffer.size() - txHead);
+        stats.writeCalls++;
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        stats.bytesWritten += ret;
+        txHead += ret;
+    }
+
+    // Reclaim the consumed space
+    if (txHead == txBuffer.size()) {
+        txBuffer.clear();
+        txHead = 0;
+    } else if (txHead > txBuffer.size() / 2) {
+        txBuffer.erase(txBuffer.begin(), txBuffer.begin() + txHead);
+        txHead = 0;
+    }
+
+    updateEvents();
+
+    if (wasCongested && pending() <= lowWatermark) {
+        wasCongested = false;
+        if (writableCallback) {
+            writableCallback();
+        }
+    }
+
+    return true;
+}
+
+void Transport::updateEvents ()
+{
+    if (fd < 0 || connecting) {
+        return;
+    }
+
+    bool pollOut = !paused && pending() > 0;
+    if (pollOut != pollingOut) {
+        loop.modify(fd, pollOut ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+        pollingOut = pollOut;
+    }
+}
+
+} // guio
@@ -0,0 +1,38 @@
+/*
+ * GUI-O host library
+ * Minimal check macros for the unit tests.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef GUIO_HOST__TESTS_CHECK_H
+#define GUIO_HOST__TESTS_CHECK_H
+
+#include <cstdio>
+
+
+// Failed checks are reported and counted; the test's main() returns
+// check_result()
+static unsigned int check_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            check_failures++; \
+        } \
+    } while (0)
+
+static inline int check_result ()
+{
+    if (check_failures) {
+        fprintf(stderr, "%u check(s) failed\n", check_failures);
+        return 1;
+    }
+    return 0;
+}
+
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * GUI-O host library
+ * Tests of the command builder.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/command_builder.h"
+
+#include "check.h"
+
+#include <string>
+
+using namespace guio;
+
+
+static std::string contents (const CommandBuilder &builder)
+{
+    return std::string(builder.data(), builder.size());
+}
+
+static void testBatching ()
+{
+    CommandBuilder builder;
+    CHECK(builder.empty());
+    CHECK(builder.count() == 0);
+
+    // Commands accumulate in a single buffer, in order
+    builder.guio("@cls").guio("@guis BGC:#FFFFFF").bridge("!PING");
+    builder.guiof("@lbCount1 TXT:\"Toggles (session): %d\"", 42);
+
+    CHECK(!builder.empty());
+    CHECK(builder.count() == 4);
+    CHECK(contents(builder) == "$@cls\r\n$@guis BGC:#FFFFFF\r\n!PING\r\n$@lbCount1 TXT:\"Toggles (session): 42\"\r\n");
+
+    // Clearing keeps the capacity, and the buffer can be reused
+    builder.clear();
+    CHECK(builder.empty());
+    CHECK(builder.count() == 0);
+    CHECK(builder.size() == 0);
+
+    builder.guio("@hls 500");
+    CHECK(contents(builder) == "$@hls 500\r\n");
+}
+
+static void testChannels ()
+{
+    CommandBuilder builder;
+
+    // Tag applies to GUI-O commands, but not to bridge commands
+    builder.channel(2).guio("@cls").guiof("@tg%d CRE:1", 1).bridge("!CHSTATS");
+    builder.channel(-1).guio("@sls");
+    builder.channel(0).guio("@clh");
+
+    CHECK(contents(builder) == "$2:@cls\r\n$2:@tg1 CRE:1\r\n!CHSTATS\r\n$@sls\r\n$0:@clh\r\n");
+}
+
+static void testLongFormat ()
+{
+    // Formatted command longer than the initial space
+    CommandBuilder builder;
+    std::string text(5000, 'x');
+
+    builder.guio("@cls");
+    builder.guiof("@lb1 TXT:\"%s\"", text.c_str());
+    builder.guio("@sls");
+
+    CHECK(builder.count() == 3);
+    CHECK(contents(builder) == "$@cls\r\n$@lb1 TXT:\"" + text + "\"\r\n$@sls\r\n");
+}
+
+
+int main ()
+{
+    testBatching();
+    testChannels();
+    testLongFormat();
+
+    return check_result();
+}
@@ -0,0 +1,73 @@
+/*
+ * GUI-O host library
+ * Tests of the event loop (idle callbacks).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/event_loop.h"
+
+#include "check.h"
+
+#include <string>
+
+using namespace guio;
+
+
+// Idle callbacks may remove themselves or others, and add new ones,
+// while the idle callbacks are being run
+static void testIdleCallbacks ()
+{
+    EventLoop loop;
+
+    std::string calls;
+    unsigned int iterations = 0;
+    int self = -1;
+    int other = -1;
+
+    // Runs once, and removes itself
+    self = loop.addIdleCallback([&] () {
+        calls += 'a';
+        loop.removeIdleCallback(self);
+    });
+
+    // Removes the next one before it runs, and adds a new one (which
+    // runs from the next iteration on)
+    loop.addIdleCallback([&] () {
+        calls += 'b';
+        if (other >= 0) {
+            loop.removeIdleCallback(other);
+            other = -1;
+            loop.addIdleCallback([&] () {
+                calls += 'd';
+            });
+        }
+    });
+    other = loop.addIdleCallback([&] () {
+        calls += 'c';
+    });
+
+    // Keeps the loop from blocking, and stops it after three iterations
+    loop.addIdleCallback([&] () {
+        if (++iterations == 3) {
+            loop.stop();
+        } else {
+            loop.defer([] () {});
+        }
+    });
+
+    loop.run();
+
+    CHECK(iterations == 3);
+    CHECK(calls == "abbdbd");
+}
+
+
+int main ()
+{
+    testIdleCallbacks();
+
+    return check_result();
+}
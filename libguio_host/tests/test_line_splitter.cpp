@@ -0,0 +1,114 @@
+/*
+ * GUI-O host library
+ * Tests of the line splitter.
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/line_splitter.h"
+
+#include "check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace guio;
+
+
+// Feeds the data in chunks of given size (as separate reads), and
+// collects the lines
+static std::vector<std::string> split (LineSplitter &splitter, const std::string &data, size_t chunk)
+{
+    std::vector<std::string> lines;
+
+    for (size_t offset = 0; offset < data.size(); ) {
+        char *ptr = splitter.writePtr();
+        size_t size = std::min({ chunk, data.size() - offset, splitter.writeSpace() });
+        memcpy(ptr, data.data() + offset, size);
+        splitter.commit(size);
+        offset += size;
+
+        std::string_view line;
+        while (splitter.next(line)) {
+            lines.emplace_back(line);
+        }
+    }
+
+    return lines;
+}
+
+static void testTerminators ()
+{
+    static const std::string data = "$@cls\r\n!PING\n\r\n\n$@lbTime2 TXT:\"14:21:05\"\r\n";
+    static const std::vector<std::string> expected = { "$@cls", "!PING", "", "", "$@lbTime2 TXT:\"14:21:05\"" };
+
+    // Any split across reads, including CR and LF in separate reads
+    for (size_t chunk = 1; chunk <= data.size(); chunk++) {
+        LineSplitter splitter;
+        CHECK(split(splitter, data, chunk) == expected);
+    }
+}
+
+static void testPartialLine ()
+{
+    LineSplitter splitter;
+    std::string_view line;
+
+    // No line until its terminator arrives
+    CHECK(split(splitter, "$@tg1 CR", 64).empty());
+    CHECK(!splitter.next(line));
+    CHECK(split(splitter, "E:1\r", 64).empty());
+
+    std::vector<std::string> lines = split(splitter, "\n$@hls", 64);
+    CHECK(lines.size() == 1 && lines[0] == "$@tg1 CRE:1");
+
+    lines = split(splitter, " 500\r\n", 64);
+    CHECK(lines.size() == 1 && lines[0] == "$@hls 500");
+}
+
+static void testCompaction ()
+{
+    // Partial lines are moved to the front when running out of space;
+    // many lines through a small buffer must come out intact
+    std::string data;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 200; i++) {
+        std::string line = "$@lbCount1 TXT:\"Toggles (session): " + std::to_string(i) + "\"";
+        expected.push_back(line);
+        data += line + "\r\n";
+    }
+
+    for (size_t chunk : { 1, 7, 13, 64 }) {
+        LineSplitter splitter(64);
+        CHECK(split(splitter, data, chunk) == expected);
+        CHECK(splitter.getTruncatedLines() == 0);
+    }
+}
+
+static void testTruncation ()
+{
+    // Line longer than the capacity is truncated to the capacity, and
+    // its remainder is discarded
+    LineSplitter splitter(16);
+    std::vector<std::string> lines = split(splitter, std::string(40, 'x') + "\r\n!PING\r\n", 5);
+
+    CHECK(lines.size() == 2);
+    CHECK(lines.size() == 2 && lines[0] == std::string(16, 'x'));
+    CHECK(lines.size() == 2 && lines[1] == "!PING");
+    CHECK(splitter.getTruncatedLines() == 1);
+}
+
+
+int main ()
+{
+    testTerminators();
+    testPartialLine();
+    testCompaction();
+    testTruncation();
+
+    return check_result();
+}
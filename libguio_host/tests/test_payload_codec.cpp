@@ -0,0 +1,190 @@
+/*
+ * GUI-O host library
+ * Tests of the payload codec (shared with the bridge).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "payload_codec.h"
+
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+
+// Builds a compressed payload from raw (unescaped) tokens
+static std::string encode (const std::string &tokens)
+{
+    std::string payload(1, PAYLOAD_CODEC_PREFIX);
+    for (char c : tokens) {
+        if (c == 0x00 || c == '\n' || c == '\r' || c == 0x11 || c == 0x13 || c == 0x1B) {
+            payload += (char)0x1B;
+            payload += (char)(c ^ 0x40);
+        } else {
+            payload += c;
+        }
+    }
+    return payload;
+}
+
+// Match token of given length (3 .. 18) and distance (1 .. 2048)
+static std::string match (unsigned int length, unsigned int distance)
+{
+    std::string token;
+    token += (char)(0x80 | ((length - 3) << 3) | ((distance - 1) >> 8));
+    token += (char)((distance - 1) & 0xFF);
+    return token;
+}
+
+static int decompress (const std::string &payload, char *output, size_t outputSize)
+{
+    return PayloadCodec::decompress(payload.data(), payload.size(), output, outputSize);
+}
+
+
+// Every pass-through message of the corpus must survive the round trip,
+// and the compressed form must be safe to send as a serial line
+static void testRoundTrip (PayloadCodec &codec, const std::filesystem::path &corpus)
+{
+    unsigned int messages = 0;
+    unsigned int compressed = 0;
+    size_t inputBytes = 0;
+    size_t outputBytes = 0;
+
+    for (const auto &entry : std::filesystem::directory_iterator(corpus)) {
+        std::ifstream file(entry.path());
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.size() < 2 || line[0] != '$') {
+                continue;
+            }
+
+            const std::string message = line.substr(1);
+            messages++;
+
+            char output[PAYLOAD_CODEC_MAX_MESSAGE];
+            size_t length = codec.compress(message.data(), message.size(), output, sizeof(output));
+            if (!length) {
+                continue;
+            }
+            compressed++;
+            inputBytes += message.size();
+            outputBytes += length;
+
+            CHECK(length < message.size());
+            CHECK(PayloadCodec::isCompressed(output, length));
+            for (size_t i = 0; i < length; i++) {
+                CHECK(output[i] != 0x00 && output[i] != '\n' && output[i] != '\r' && output[i] != 0x11 && output[i] != 0x13);
+            }
+
+            char decoded[PAYLOAD_CODEC_MAX_MESSAGE];
+            int decodedLength = PayloadCodec::decompress(output, length, decoded, sizeof(decoded));
+            CHECK(decodedLength == (int)message.size());
+            CHECK(decodedLength >= 0 && message.compare(0, message.size(), decoded, decodedLength) == 0);
+
+            // Output that is one byte short must be rejected
+            if (decodedLength > 0) {
+                CHECK(PayloadCodec::decompress(output, length, decoded, decodedLength - 1) == -1);
+            }
+
+            // Truncated payloads must be rejected or decode to a prefix
+            // of the message
+            for (size_t truncated = 1; truncated < length; truncated++) {
+                int prefixLength = PayloadCodec::decompress(output, truncated, decoded, sizeof(decoded));
+                CHECK(prefixLength < (int)message.size());
+                CHECK(prefixLength < 0 || message.compare(0, prefixLength, decoded, prefixLength) == 0);
+            }
+        }
+    }
+
+    CHECK(messages > 0);
+    CHECK(compressed > 0);
+
+    printf("Round trip: %u messages, %u compressed (%zu -> %zu bytes)\n", messages, compressed, inputBytes, outputBytes);
+}
+
+static void testMalformed ()
+{
+    char output[64];
+
+    // Not compressed, or empty
+    CHECK(decompress("", output, sizeof(output)) == -1);
+    CHECK(decompress("abc", output, sizeof(output)) == -1);
+    CHECK(decompress(encode(""), output, sizeof(output)) == 0);
+
+    // Truncated back-reference (second byte missing)
+    CHECK(decompress(encode("ab" + match(3, 1).substr(0, 1)), output, sizeof(output)) == -1);
+
+    // Truncated escape sequence and literal
+    CHECK(decompress(encode("ab") + (char)0x1B, output, sizeof(output)) == -1);
+    CHECK(decompress(encode("ab\x01"), output, sizeof(output)) == -1);
+
+    // Unescaped control characters
+    CHECK(decompress(encode("ab\x05"), output, sizeof(output)) == -1);
+    CHECK(decompress(encode("ab\x7F"), output, sizeof(output)) == -1);
+
+    // Output overflow (literal and match)
+    CHECK(decompress(encode("abcd"), output, 3) == -1);
+    CHECK(decompress(encode("a" + match(18, 1)), output, 18) == -1);
+}
+
+static void testBackReferences ()
+{
+    char output[64];
+
+    // Overlapping match repeats the preceding character
+    int length = decompress(encode("a" + match(18, 1)), output, sizeof(output));
+    CHECK(length == 19);
+    CHECK(length == 19 && std::string(output, length) == std::string(19, 'a'));
+
+    // Match reaching back beyond the output resolves into the dictionary;
+    // the dictionary ends with the label template
+    length = decompress(encode(match(5, 5)), output, sizeof(output));
+    CHECK(length == 5 && memcmp(output, "TXT:\"", 5) == 0);
+
+    // Distances are valid up to the start of the dictionary, and invalid
+    // beyond it; the boundary shifts with the decoded output
+    unsigned int boundary = 0;
+    for (unsigned int distance = 3; distance <= 2048; distance++) {
+        if (decompress(encode(match(3, distance)), output, sizeof(output)) == -1) {
+            boundary = distance - 1;
+            break;
+        }
+    }
+    CHECK(boundary >= 3 && boundary <= 1024);
+    for (unsigned int distance = boundary + 1; distance <= 2048; distance++) {
+        CHECK(decompress(encode(match(3, distance)), output, sizeof(output)) == -1);
+    }
+    CHECK(decompress(encode("x" + match(3, boundary + 1)), output, sizeof(output)) == 4);
+    CHECK(decompress(encode("x" + match(3, boundary + 2)), output, sizeof(output)) == -1);
+
+    // Match of the whole dictionary start
+    length = decompress(encode(match(6, boundary)), output, sizeof(output));
+    CHECK(length == 6 && memcmp(output, "@init ", 6) == 0);
+}
+
+
+int main (int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <corpus directory>\n", argv[0]);
+        return 1;
+    }
+
+    PayloadCodec codec;
+
+    testRoundTrip(codec, argv[1]);
+    testMalformed();
+    testBackReferences();
+
+    return check_result();
+}
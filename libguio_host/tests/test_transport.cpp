@@ -0,0 +1,217 @@
+/*
+ * GUI-O host library
+ * Tests of the transport (TCP connection and serial hang-up).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "guio/event_loop.h"
+#include "guio/transport.h"
+
+#include "check.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace guio;
+
+
+// Listening socket on loopback, on an ephemeral port
+static int listenLoopback (uint16_t &port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 1) < 0
+        || getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &length) < 0) {
+        throw std::system_error(errno, std::generic_category(), "listen");
+    }
+
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Stops the loop if the test does not finish in time
+static int addTimeout (EventLoop &loop, bool &timedOut)
+{
+    return loop.addTimer(2000, [&loop, &timedOut] () {
+        timedOut = true;
+        loop.stop();
+    });
+}
+
+
+static void testTcpConnect ()
+{
+    EventLoop loop;
+    bool timedOut = false;
+    int timer = addTimeout(loop, timedOut);
+
+    uint16_t port;
+    int listenFd = listenLoopback(port);
+    int peerFd = -1;
+    std::string received;
+
+    std::unique_ptr<Transport> transport = Transport::openTcp(loop, "127.0.0.1", port);
+    CHECK(transport->isOpen());
+
+    // Written before the connection is established; must be queued
+    CHECK(transport->write("!PING\r\n", 7));
+
+    // Peer: echoes the line back, then closes the connection
+    loop.add(listenFd, EPOLLIN, [&] (uint32_t) {
+        peerFd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (peerFd < 0) {
+            return;
+        }
+        loop.add(peerFd, EPOLLIN, [&] (uint32_t) {
+            char buffer[64];
+            ssize_t len = ::read(peerFd, buffer, sizeof(buffer));
+            if (len > 0) {
+                received.append(buffer, len);
+            }
+            if (received == "!PING\r\n") {
+                CHECK(::write(peerFd, "!PONG\r\n", 7) == 7);
+                loop.remove(peerFd);
+                ::close(peerFd);
+                peerFd = -1;
+            }
+        });
+    });
+
+    std::string reply;
+    bool closed = false;
+    transport->setReadCallback([&] () {
+        char buffer[64];
+        ssize_t len;
+        while ((len = transport->read(buffer, sizeof(buffer))) > 0) {
+            reply.append(buffer, len);
+        }
+        if (len < 0) {
+            closed = true;
+            transport->close();
+            loop.stop();
+        }
+    });
+
+    loop.run();
+
+    CHECK(!timedOut);
+    CHECK(!transport->isConnecting());
+    CHECK(received == "!PING\r\n");
+    CHECK(reply == "!PONG\r\n");
+    CHECK(closed);
+
+    loop.removeTimer(timer);
+    loop.remove(listenFd);
+    ::close(listenFd);
+}
+
+static void testTcpRefused ()
+{
+    EventLoop loop;
+    bool timedOut = false;
+    int timer = addTimeout(loop, timedOut);
+
+    // Port that was just released; nothing listens on it
+    uint16_t port;
+    ::close(listenLoopback(port));
+
+    // Refusal is reported either right away, or via closed callback
+    bool closed = false;
+    try {
+        std::unique_ptr<Transport> transport = Transport::openTcp(loop, "127.0.0.1", port);
+        transport->setClosedCallback([&] () {
+            closed = true;
+            loop.stop();
+        });
+        CHECK(transport->write("!PING\r\n", 7)); // queued
+        loop.run();
+        CHECK(!transport->isOpen());
+    } catch (const std::system_error &e) {
+        closed = e.code().value() == ECONNREFUSED;
+    }
+
+    CHECK(!timedOut);
+    CHECK(closed);
+
+    loop.removeTimer(timer);
+}
+
+static void testSerialHangup ()
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        printf("Skipping serial hang-up test (no pseudo-terminal)\n");
+        if (master >= 0) {
+            ::close(master);
+        }
+        return;
+    }
+
+    EventLoop loop;
+    bool timedOut = false;
+    int timer = addTimeout(loop, timedOut);
+
+    std::unique_ptr<Transport> transport = Transport::openSerial(loop, ptsname(master), 115200);
+
+    // The other side hangs up after the data was received (the pseudo-
+    // terminal discards unread data on hang-up); the transport is closed
+    // once, even though the hang-up remains signalled and the reader
+    // does not act on it
+    std::string received;
+    unsigned int closedCalls = 0;
+    transport->setReadCallback([&] () {
+        char buffer[64];
+        ssize_t len;
+        while ((len = transport->read(buffer, sizeof(buffer))) > 0) {
+            received.append(buffer, len);
+        }
+        if (received == "$@cls\r\n" && master >= 0) {
+            ::close(master);
+            master = -1;
+        }
+    });
+    transport->setClosedCallback([&] () {
+        closedCalls++;
+        loop.defer([&loop] () {
+            loop.stop();
+        });
+    });
+
+    CHECK(::write(master, "$@cls\r\n", 7) == 7);
+
+    loop.run();
+
+    CHECK(!timedOut);
+    CHECK(closedCalls == 1);
+    CHECK(!transport->isOpen());
+    CHECK(received == "$@cls\r\n");
+
+    loop.removeTimer(timer);
+}
+
+
+int main ()
+{
+    testTcpConnect();
+    testTcpRefused();
+    testSerialHangup();
+
+    return check_result();
+}
@@ -0,0 +1,120 @@
+/*
+ * GUI-O host library
+ * Tests of the UI state cache (shared with the bridge).
+ *
+ * Copyright (C) 2020, Rok Mandeljc
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ui_cache.h"
+
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+
+static void incoming (UiCache &cache, uint8_t channel, const std::string &line)
+{
+    cache.processIncoming(channel, (const uint8_t *)line.data(), line.size());
+}
+
+static std::vector<std::string> replay (UiCache &cache, uint8_t channel)
+{
+    std::vector<std::string> lines;
+    if (!cache.replay(channel, [&lines] (const char *line) { lines.push_back(line); })) {
+        lines.push_back("<not replayed>");
+    }
+    return lines;
+}
+
+
+static void testSuppression ()
+{
+    UiCache cache;
+    cache.setEnabled(0, true);
+
+    CHECK(cache.processOutgoing(0, "@cls"));
+    CHECK(cache.processOutgoing(0, "|TG UID:tg1 X:10 VAL:0"));
+    CHECK(!cache.processOutgoing(0, "@tg1 VAL:0"));
+    CHECK(cache.processOutgoing(0, "@tg1 VAL:1"));
+    CHECK(!cache.processOutgoing(0, "@tg1 VAL:1 X:10"));
+    CHECK(cache.getSuppressed(0) == 2);
+
+    // Acknowledgements and other channels are never suppressed
+    CHECK(cache.processOutgoing(0, "@tg1 CRE:1"));
+    CHECK(cache.processOutgoing(0, "@tg1 CRE:1"));
+    CHECK(cache.processOutgoing(1, "@tg1 VAL:1"));
+}
+
+// User changes the widget, and the back-end resets it to the cached
+// value; the reset must reach the front-end
+static void testFrontEndEvents ()
+{
+    UiCache cache;
+    cache.setEnabled(0, true);
+
+    const std::string init = "@init DPW:1080 DPH:1920";
+    cache.storeInit(0, (const uint8_t *)init.data(), init.size());
+    CHECK(cache.processOutgoing(0, "|SL UID:sl1 VAL:0"));
+    CHECK(cache.processOutgoing(0, "|TG UID:tg1 VAL:0"));
+
+    incoming(cache, 0, "@sl1 40");
+    CHECK(cache.processOutgoing(0, "@sl1 VAL:0"));
+    CHECK(!cache.processOutgoing(0, "@sl1 VAL:0"));
+
+    // Replay restores the front-end's last state
+    incoming(cache, 0, "?@tg1 1");
+    CHECK(cache.canReplay(0, (const uint8_t *)init.data(), init.size()));
+    std::vector<std::string> lines = replay(cache, 0);
+    CHECK(lines.size() == 2);
+    CHECK(lines.size() == 2 && lines[0] == "|SL UID:sl1 VAL:0");
+    CHECK(lines.size() == 2 && lines[1] == "|TG UID:tg1 VAL:1");
+    CHECK(cache.processOutgoing(0, "@tg1 VAL:0"));
+
+    // Events of other widgets do not affect the cache
+    incoming(cache, 0, "@bt9 1");
+    CHECK(!cache.processOutgoing(0, "@tg1 VAL:0"));
+
+    // Widget without a cached value; its state is unknown
+    CHECK(cache.processOutgoing(0, "|BT UID:bt1 TXT:\"Reset\""));
+    incoming(cache, 0, "@bt1 1");
+    CHECK(cache.processOutgoing(0, "@tg1 VAL:0"));
+    CHECK(!cache.canReplay(0, (const uint8_t *)init.data(), init.size()));
+    CHECK(replay(cache, 0) == std::vector<std::string>{"<not replayed>"});
+}
+
+static void testLongLines ()
+{
+    UiCache cache;
+    cache.setEnabled(0, true);
+
+    CHECK(cache.processOutgoing(0, "@cls"));
+    CHECK(cache.processOutgoing(0, "|LB UID:lb1 TXT:\"a\""));
+    CHECK(!cache.processOutgoing(0, "@lb1 TXT:\"a\""));
+
+    // Text longer than the record length; the label's state is unknown
+    // afterwards
+    const std::string text(300, 'x');
+    CHECK(cache.processOutgoing(0, ("@lb1 TXT:\"" + text + "\"").c_str()));
+    CHECK(cache.processOutgoing(0, "@lb1 TXT:\"a\""));
+    CHECK(cache.getUsed() == 0);
+
+    // Longest cached line replays intact
+    CHECK(cache.processOutgoing(0, "@cls"));
+    std::string line = "|LB UID:lb1 TXT:\"" + std::string(255 - 18, 'y') + "\"";
+    CHECK(line.size() == 255);
+    CHECK(cache.processOutgoing(0, line.c_str()));
+    CHECK(replay(cache, 0) == std::vector<std::string>{line});
+}
+
+
+int main ()
+{
+    testSuppression();
+    testFrontEndEvents();
+    testLongLines();
+
+    return check_result();
+}
@@ -0,0 +1,370 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Traffic trace tool for GUI-O ESP8266 bridge: fetch, inspect and replay
+# traces captured by the bridge (!CAPTURE command).
+#
+# Copyright (C) 2020, Rok Mandeljc
+#
+# SPDX-License-Identifier: BSD-3-Clause
+
+import argparse
+import logging
+import threading
+import time
+
+import serial
+import paho.mqtt.client as mqtt
+
+
+# Keep in sync with definitions in trace_capture.h
+TRACE_MAGIC = b"GTRC"
+TRACE_VERSIONS = (1, 2)
+
+TRACE_SERIAL_IN = 0
+TRACE_MQTT_IN = 1
+TRACE_MQTT_OUT = 2
+TRACE_TIMESTAMP = 3  # version 2; absolute time in milliseconds
+
+_DIRECTION_NAMES = {
+    TRACE_SERIAL_IN: "serial-in",
+    TRACE_MQTT_IN: "mqtt-in",
+    TRACE_MQTT_OUT: "mqtt-out",
+}
+
+
+class TraceRecord:
+    __slots__ = ("timestamp", "direction", "channel", "payload")
+
+    def __init__(self, timestamp, direction, channel, payload):
+        self.timestamp = timestamp  # microseconds since start of capture
+        self.direction = direction
+        self.channel = channel
+        self.payload = payload
+
+
+def _read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def read_trace(filename):
+    with open(filename, "rb") as fp:
+        data = fp.read()
+
+    if data[0:4] != TRACE_MAGIC:
+        raise ValueError(f"{filename}: not a GUI-O trace file!")
+    if data[4] not in TRACE_VERSIONS:
+        raise ValueError(f"{filename}: unsupported trace version {data[4]}!")
+
+    records = []
+    timestamp = 0
+    pos = 5
+    while pos < len(data):
+        delta, pos = _read_varint(data, pos)
+        record_type = data[pos]
+        pos += 1
+        length, pos = _read_varint(data, pos)
+        payload = data[pos:pos + length]
+        pos += length
+
+        timestamp += delta
+
+        # Absolute time, emitted when the time since the previous record
+        # would overflow the bridge's 32-bit delta; not a record itself
+        if record_type & 0x0F == TRACE_TIMESTAMP:
+            elapsed, _ = _read_varint(payload, 0)
+            timestamp = elapsed * 1000
+            continue
+
+        records.append(
+            TraceRecord(timestamp, record_type & 0x0F, record_type >> 4, payload)
+        )
+
+    return records
+
+
+def _parse_topic_map(entries):
+    # ch=topic pairs
+    topics = {}
+    for entry in entries or []:
+        channel, topic = entry.split("=", 1)
+        topics[int(channel)] = topic
+    return topics
+
+
+def command_fetch(args):
+    logger = logging.getLogger("fetch")
+
+    with serial.Serial(args.port, args.baudrate, timeout=args.timeout) as port:
+        port.reset_input_buffer()
+        port.write(b"!CAPTURE DUMP\r\n")
+
+        data = bytearray()
+        while True:
+            line = port.readline()
+            if not line:
+                raise RuntimeError("Timeout while waiting for trace data!")
+            line = line.rstrip(b"\r\n")
+            if line.startswith(b"!CAPDATA "):
+                data += bytes.fromhex(line[9:].decode("ascii"))
+            elif line.startswith(b"!CAPEND "):
+                expected = int(line[8:])
+                if expected != len(data):
+                    raise RuntimeError(
+                        f"Trace size mismatch: received {len(data)}, expected {expected}!"
+                    )
+                break
+            elif line == b"!ERROR":
+                raise RuntimeError("Bridge failed to dump the trace (capture still active?)")
+
+    with open(args.output, "wb") as fp:
+        fp.write(data)
+
+    logger.info(f"Stored {len(data)} bytes of trace to {args.output}")
+
+
+def command_dump(args):
+    records = read_trace(args.trace)
+    for record in records:
+        payload = record.payload.decode("utf-8", errors="replace")
+        print(
+            f"{record.timestamp / 1e6:12.6f} {_DIRECTION_NAMES.get(record.direction, record.direction):9s} "
+            f"ch{record.channel} {payload}"
+        )
+
+
+def command_replay(args):
+    logger = logging.getLogger("replay")
+
+    records = read_trace(args.trace)
+    logger.info(f"Loaded {len(records)} records from {args.trace}")
+
+    # Speed factor; 0 = as fast as possible
+    speed = 0.0 if args.speed == "max" else float(args.speed)
+
+    # Topics used to inject front-end messages (the bridge's subscribe
+    # topics) and to observe bridge's output (the bridge's publish topics)
+    inject_topics = _parse_topic_map(args.inject_topic)
+    observe_topics = _parse_topic_map(args.observe_topic)
+
+    received = 0
+    received_lock = threading.Lock()
+
+    def on_message(client, userdata, message):
+        nonlocal received
+        with received_lock:
+            received += 1
+
+    client = None
+    if inject_topics or observe_topics:
+        client = mqtt.Client()
+        if args.mqtt_user:
+            client.username_pw_set(args.mqtt_user, args.mqtt_password)
+        client.on_message = on_message
+        client.connect(args.mqtt_host, args.mqtt_port)
+        for topic in observe_topics.values():
+            client.subscribe(topic)
+        client.loop_start()
+
+    port = serial.Serial(args.port, args.baudrate)
+
+    expected = 0
+    sent = 0
+    skipped = 0
+    skipped_commands = 0
+
+    start = time.monotonic()
+    for record in records:
+        if speed:
+            # Wait until the record's (scaled) time
+            delay = record.timestamp / 1e6 / speed - (time.monotonic() - start)
+            if delay > 0:
+                time.sleep(delay)
+
+        if record.direction == TRACE_SERIAL_IN:
+            # Bridge commands (e.g., !CHANNEL, !CLEAR_PARAMS, !REBOOT)
+            # would reconfigure the bench bridge; replay them only on
+            # explicit request
+            if record.payload.startswith(b"!") and not args.replay_commands:
+                skipped_commands += 1
+                continue
+            port.write(record.payload + b"\r\n")
+            sent += 1
+        elif record.direction == TRACE_MQTT_IN:
+            topic = inject_topics.get(record.channel)
+            if topic and client:
+                client.publish(topic, record.payload)
+                sent += 1
+            else:
+                skipped += 1
+        elif record.direction == TRACE_MQTT_OUT:
+            # Output of the bridge; counted for comparison
+            if record.channel in observe_topics:
+                expected += 1
+
+    port.flush()
+    elapsed = time.monotonic() - start
+
+    # Give the bridge some time to process the tail of the trace
+    if client:
+        time.sleep(args.drain_time)
+        client.loop_stop()
+        client.disconnect()
+    port.close()
+
+    logger.info(f"Replayed {sent} records in {elapsed:.3f} s ({sent / elapsed if elapsed else 0:.1f} records/s)")
+    if skipped:
+        logger.info(f"Skipped {skipped} MQTT records without injection topic")
+    if skipped_commands:
+        logger.info(f"Skipped {skipped_commands} bridge command records (use --replay-commands to replay them)")
+    if observe_topics:
+        logger.info(f"Bridge published {received} messages (trace: {expected})")
+
+
+def main():
+    # Logging
+    logging.basicConfig(encoding="utf-8", level=logging.INFO)
+
+    # Command-line parser
+    parser = argparse.ArgumentParser(
+        description="GUI-O ESP8266 bridge traffic trace tool.",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    parser.add_argument(
+        "--log-level",
+        metavar="level",
+        choices=('DEBUG', 'INFO', 'WARN', 'ERROR', 'CRITICAL'),
+        help="Log level.",
+        default='INFO',
+    )
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    def add_serial_arguments(subparser):
+        subparser.add_argument(
+            "--port",
+            metavar="serial_port",
+            type=str,
+            help="Serial port.",
+            default="/dev/ttyUSB0",
+        )
+        subparser.add_argument(
+            "--baudrate",
+            metavar="baudrate",
+            type=int,
+            help="Communication baudrate.",
+            default=115200,
+        )
+
+    # fetch
+    subparser = subparsers.add_parser(
+        "fetch",
+        help="Fetch the captured trace from the bridge.",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    add_serial_arguments(subparser)
+    subparser.add_argument(
+        "--timeout",
+        metavar="seconds",
+        type=float,
+        help="Serial read timeout.",
+        default=5.0,
+    )
+    subparser.add_argument("output", type=str, help="Output trace file.")
+    subparser.set_defaults(func=command_fetch)
+
+    # dump
+    subparser = subparsers.add_parser(
+        "dump",
+        help="Print the trace in human-readable form.",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    subparser.add_argument("trace", type=str, help="Trace file.")
+    subparser.set_defaults(func=command_dump)
+
+    # replay
+    subparser = subparsers.add_parser(
+        "replay",
+        help="Replay the trace into the bridge.",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    add_serial_arguments(subparser)
+    subparser.add_argument(
+        "--speed",
+        metavar="factor",
+        type=str,
+        help="Replay speed factor (e.g., 1, 10) or 'max' for maximum speed.",
+        default="1",
+    )
+    subparser.add_argument(
+        "--mqtt-host",
+        metavar="host",
+        type=str,
+        help="MQTT broker host.",
+        default="localhost",
+    )
+    subparser.add_argument(
+        "--mqtt-port",
+        metavar="port",
+        type=int,
+        help="MQTT broker port.",
+        default=1883,
+    )
+    subparser.add_argument(
+        "--mqtt-user",
+        metavar="user",
+        type=str,
+        help="MQTT user name.",
+        default=None,
+    )
+    subparser.add_argument(
+        "--mqtt-password",
+        metavar="password",
+        type=str,
+        help="MQTT user password.",
+        default=None,
+    )
+    subparser.add_argument(
+        "--inject-topic",
+        metavar="ch=topic",
+        action="append",
+        help="Topic to which front-end messages of channel are published (bridge's subscribe topic).",
+    )
+    subparser.add_argument(
+        "--observe-topic",
+        metavar="ch=topic",
+        action="append",
+        help="Topic on which bridge's messages of channel are counted (bridge's publish topic).",
+    )
+    subparser.add_argument(
+        "--replay-commands",
+        action="store_true",
+        help="Also replay the recorded bridge commands (! lines); these may reconfigure, wipe or reboot the bridge.",
+    )
+    subparser.add_argument(
+        "--drain-time",
+        metavar="seconds",
+        type=float,
+        help="Time to wait for bridge's output after the replay.",
+        default=2.0,
+    )
+    subparser.add_argument("trace", type=str, help="Trace file.")
+    subparser.set_defaults(func=command_replay)
+
+    args = parser.parse_args()
+
+    # Apply log level to root logger
+    logging.getLogger().setLevel(args.log_level)
+
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()